@@ -1,13 +1,11 @@
 #pragma once
 
-#include "camera.h"
+#include "debug_draw.h"
 #include "maths.h"
-#include "shader.h"
+
+#include <vector>
 
 struct Axis {
-    unsigned int VAO;
-    unsigned int VBO;
-    Shader shader;
     std::vector<Vec3> vertices;
     Vec3 color;
 };
@@ -18,5 +16,5 @@ struct Axes {
     Axis z_axis;
 };
 
-void draw(Axes axes, const Camera &camera);
-Axes make_axes();
\ No newline at end of file
+void draw(const Axes &axes, DebugDraw &debug);
+Axes make_axes();
@@ -0,0 +1,293 @@
+#include "bake.h"
+
+#include "logging.h"
+#include "memory.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+constexpr char bake_magic[4] = {'B', 'A', 'K', 'E'};
+constexpr uint32_t bake_version = 1;
+
+uint64_t geometry_hash(const Grid &grid) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    auto add = [&](int32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 0x100000001b3;
+        }
+    };
+    add(grid.rows);
+    add(grid.cols);
+    for (const Cell &cell : grid.cells) {
+        add(cell.type);
+        add(cell.prop.axis);
+    }
+    add(bake_version);
+    return hash;
+}
+
+bool bake_fits(const Grid &grid) {
+    static int max_size = [] {
+        int size = 0;
+        glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &size);
+        return size;
+    }();
+    int64_t size_x = (int64_t)grid.cols * bake_samples_per_cell;
+    int64_t size_z = (int64_t)grid.rows * bake_samples_per_cell;
+    return size_x <= max_size && size_z <= max_size && bake_levels <= max_size &&
+           size_x * bake_levels * size_z <= bake_max_samples;
+}
+
+// Spread evenly over the upper hemisphere
+std::vector<Vec3> hemisphere_directions(int n) {
+    std::vector<Vec3> directions;
+    float golden_angle = M_PI * (3 - std::sqrt(5.f));
+    for (int i = 0; i < n; ++i) {
+        float y = 1 - (i + 0.5f) / n;
+        float r = std::sqrt(1 - y * y);
+        float phi = golden_angle * i;
+        directions.push_back({r * std::cos(phi), y, r * std::sin(phi)});
+    }
+    return directions;
+}
+
+uint8_t to_byte(float value) { return std::clamp(value, 0.f, 1.f) * 255 + 0.5f; }
+
+// Bakes the column of samples at (x, z) from the top. Only the ambient occlusion of the samples
+// for which needs_ao(p) is true is computed again, and the sun visibility of those for which
+// needs_sun(p, direction, distance) is true, the others keep their value.
+template <typename NeedsAo, typename NeedsSun>
+void bake_column(BakedLighting &baked, const Grid &grid, const std::vector<Vec3> &directions,
+                 int x, int z, NeedsAo needs_ao, NeedsSun needs_sun) {
+    Vec3 sun = {sun_position[0], sun_position[1], sun_position[2]};
+    float step = 1.f / bake_samples_per_cell;
+    float level_height = bake_height / bake_levels;
+    int row = z / bake_samples_per_cell;
+    int col = x / bake_samples_per_cell;
+    const Cell &cell = grid.cells[index_at(grid, row, col)];
+    float top = cell_height(cell, (x % bake_samples_per_cell + 0.5f) * step,
+                            (z % bake_samples_per_cell + 0.5f) * step);
+
+    for (int y = bake_levels - 1; y >= 0; --y) {
+        uint8_t *sample = &baked.samples[((z * baked.size_y + y) * baked.size_x + x) * 2];
+        Vec3 p = {(x + 0.5f) * step, (y + 0.5f) * level_height, -(z + 0.5f) * step};
+        // Rays from inside the geometry would only see back faces, the sample takes the value of
+        // the one above so that filtering does not leak light
+        if (p.y < top && y + 1 < bake_levels) {
+            std::memcpy(sample, sample + baked.size_x * 2, 2);
+            continue;
+        }
+
+        // Weighted by the cosine with the vertical, like light coming from the sky
+        if (needs_ao(p)) {
+            float open = 0;
+            float total = 0;
+            for (const Vec3 &d : directions) {
+                total += d.y;
+                if (raycast(grid, {p, d}, bake_ao_distance).triangle < 0) {
+                    open += d.y;
+                }
+            }
+            sample[0] = to_byte(open / total);
+        }
+
+        Vec3 to_sun = sun - p;
+        float distance = norm(to_sun);
+        Vec3 d = to_sun / distance;
+        // Nothing is higher than the volume
+        float max_distance = std::min(distance, (bake_height - p.y) / d.y);
+        if (needs_sun(p, d, max_distance)) {
+            sample[1] = raycast(grid, {p, d}, max_distance).triangle < 0 ? 255 : 0;
+        }
+    }
+}
+
+BakedLighting bake_lighting(const Grid &grid) {
+    MemoryScope scope(MemoryTag::Render);
+    Timer timer;
+    BakedLighting baked;
+    baked.hash = geometry_hash(grid);
+    baked.size_x = grid.cols * bake_samples_per_cell;
+    baked.size_y = bake_levels;
+    baked.size_z = grid.rows * bake_samples_per_cell;
+    baked.samples.resize(baked.size_x * baked.size_y * baked.size_z * 2);
+    std::vector<Vec3> directions = hemisphere_directions(bake_ao_rays);
+
+    // One row of columns per iteration, a column is needed whole to fill the samples inside
+    // platforms
+    auto always = [](auto...) { return true; };
+    parallel_for(0, baked.size_z, [&](int z) {
+        for (int x = 0; x < baked.size_x; ++x) {
+            bake_column(baked, grid, directions, x, z, always, always);
+        }
+    }, 1);
+
+    log("baked lighting of " + std::to_string(baked.samples.size() / 2) + " samples in " +
+        std::to_string(timer.seconds_elapsed()) + " s");
+    return baked;
+}
+
+// Whether the segment from p along d crosses the rectangle [min_x, max_x] x [min_z, max_z] seen
+// from above
+bool crosses_rectangle(Vec3 p, Vec3 d, float length, float min_x, float max_x, float min_z,
+                       float max_z) {
+    float t_min = 0;
+    float t_max = length;
+    float origin[2] = {p.x, p.z};
+    float direction[2] = {d.x, d.z};
+    float min[2] = {min_x, min_z};
+    float max[2] = {max_x, max_z};
+    for (int axis = 0; axis < 2; ++axis) {
+        if (direction[axis] == 0) {
+            if (origin[axis] < min[axis] || origin[axis] > max[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (min[axis] - origin[axis]) / direction[axis];
+        float t1 = (max[axis] - origin[axis]) / direction[axis];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+    }
+    return t_min <= t_max;
+}
+
+void rebake_cells(BakedLighting &baked, const Grid &grid, const std::vector<int> &changed) {
+    if (baked.size_x != grid.cols * bake_samples_per_cell ||
+        baked.size_z != grid.rows * bake_samples_per_cell) {
+        free_baked_lighting(baked);
+        baked = bake_lighting(grid);
+        return;
+    }
+    if (changed.empty()) {
+        return;
+    }
+    MemoryScope scope(MemoryTag::Render);
+    Timer timer;
+
+    // Rectangle around the changed cells in world space
+    float min_x = grid.cols, max_x = 0, min_z = 0, max_z = -grid.rows;
+    for (int index : changed) {
+        int row = index / grid.cols;
+        int col = index % grid.cols;
+        min_x = std::min(min_x, (float)col);
+        max_x = std::max(max_x, col + 1.f);
+        min_z = std::min(min_z, -(row + 1.f));
+        max_z = std::max(max_z, (float)-row);
+    }
+
+    // Ambient occlusion rays are short, only the samples close to the changes see them. The sun
+    // rays are long, each one is tested against the rectangle.
+    std::vector<Vec3> directions = hemisphere_directions(bake_ao_rays);
+    auto near_changes = [&](Vec3 p) {
+        return p.x > min_x - bake_ao_distance && p.x < max_x + bake_ao_distance &&
+               p.z > min_z - bake_ao_distance && p.z < max_z + bake_ao_distance;
+    };
+    auto shadowed_by_changes = [&](Vec3 p, Vec3 d, float length) {
+        return crosses_rectangle(p, d, length, min_x, max_x, min_z, max_z);
+    };
+    parallel_for(0, baked.size_z, [&](int z) {
+        for (int x = 0; x < baked.size_x; ++x) {
+            bake_column(baked, grid, directions, x, z, near_changes, shadowed_by_changes);
+        }
+    }, 1);
+    baked.hash = geometry_hash(grid);
+
+    log("baked lighting around " + std::to_string(changed.size()) + " cells in " +
+        std::to_string(timer.seconds_elapsed()) + " s");
+}
+
+bool load_baked_lighting(BakedLighting &baked, const std::string &path, uint64_t hash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    char magic[4];
+    uint32_t version;
+    uint64_t file_hash;
+    int32_t size[3];
+    file.read(magic, 4);
+    file.read((char *)&version, sizeof(version));
+    file.read((char *)&file_hash, sizeof(file_hash));
+    file.read((char *)size, sizeof(size));
+    if (!file || std::memcmp(magic, bake_magic, 4) != 0 || version != bake_version ||
+        file_hash != hash) {
+        return false;
+    }
+
+    MemoryScope scope(MemoryTag::Render);
+    std::vector<uint8_t> samples((long)size[0] * size[1] * size[2] * 2);
+    file.read((char *)samples.data(), samples.size());
+    if (!file) {
+        return false;
+    }
+    baked.hash = hash;
+    baked.size_x = size[0];
+    baked.size_y = size[1];
+    baked.size_z = size[2];
+    baked.samples = std::move(samples);
+    return true;
+}
+
+void save_baked_lighting(const BakedLighting &baked, const std::string &path) {
+    std::ofstream file(path, std::ios::binary);
+    int32_t size[3] = {baked.size_x, baked.size_y, baked.size_z};
+    file.write(bake_magic, 4);
+    file.write((const char *)&bake_version, sizeof(bake_version));
+    file.write((const char *)&baked.hash, sizeof(baked.hash));
+    file.write((const char *)size, sizeof(size));
+    file.write((const char *)baked.samples.data(), baked.samples.size());
+    if (!file) {
+        log("could not write " + path);
+    }
+}
+
+BakedLighting baked_lighting(const Grid &grid, const std::string &path) {
+    BakedLighting baked;
+    uint64_t hash = geometry_hash(grid);
+    if (load_baked_lighting(baked, path, hash)) {
+        return baked;
+    }
+    baked = bake_lighting(grid);
+    save_baked_lighting(baked, path);
+    return baked;
+}
+
+void upload(BakedLighting &baked) {
+    if (!baked.texture) {
+        glGenTextures(1, &baked.texture);
+    } else {
+        track_gpu_memory(MemoryTag::Render, -(int64_t)baked.samples.size());
+    }
+    glBindTexture(GL_TEXTURE_3D, baked.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RG8, baked.size_x, baked.size_y, baked.size_z, 0, GL_RG,
+                 GL_UNSIGNED_BYTE, baked.samples.data());
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    track_gpu_memory(MemoryTag::Render, baked.samples.size());
+}
+
+void free_baked_lighting(BakedLighting &baked) {
+    if (baked.texture) {
+        track_gpu_memory(MemoryTag::Render, -(int64_t)baked.samples.size());
+        glDeleteTextures(1, &baked.texture);
+    }
+    baked = BakedLighting{};
+}
+
+Vec3 bake_scale(const Grid &grid) {
+    return {1.f / grid.cols, 1.f / bake_height, -1.f / grid.rows};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "grid.h"
+#include "maths.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Ambient occlusion and sun shadows baked in a volume over the grid, sampled by the fragment
+// shader at the position of the fragment. The geometry of a level does not change while playing,
+// the bake runs once when the level is loaded and is cached in a file next to the level, keyed by
+// a hash of the cells.
+
+constexpr int bake_samples_per_cell = 2;
+constexpr int bake_levels = 12;
+constexpr float bake_height = 6; // above the highest wall
+constexpr int bake_ao_rays = 24;
+constexpr float bake_ao_distance = 3;
+// Larger levels are not baked, it would take minutes. About 200 x 200 cells.
+constexpr int64_t bake_max_samples = 1 << 21;
+// Same as phong_fragment.glsl
+constexpr float sun_position[3] = {5, 10, 15};
+
+struct BakedLighting {
+    uint64_t hash = 0;
+    int size_x = 0; // cols * bake_samples_per_cell
+    int size_y = 0; // bake_levels
+    int size_z = 0; // rows * bake_samples_per_cell
+    // Ambient occlusion then sun visibility for each sample, x first, in [0, 255]
+    std::vector<uint8_t> samples;
+    unsigned int texture{};
+};
+
+uint64_t geometry_hash(const Grid &grid);
+
+// False when the volume of the grid is over the sample budget or larger than a 3D texture can be,
+// the level is then drawn without baked lighting. Needs a GL context.
+bool bake_fits(const Grid &grid);
+
+// Raycasts against the grid from every sample, in parallel. The grid triangles must be built.
+BakedLighting bake_lighting(const Grid &grid);
+
+// Bakes again only the samples whose rays can reach one of the changed cells, everything when
+// the size of the grid changed. The texture must be uploaded again.
+void rebake_cells(BakedLighting &baked, const Grid &grid, const std::vector<int> &changed);
+
+// False when the file does not exist or was baked for other geometry.
+bool load_baked_lighting(BakedLighting &baked, const std::string &path, uint64_t hash);
+void save_baked_lighting(const BakedLighting &baked, const std::string &path);
+
+// Loads from the cache or bakes and saves.
+BakedLighting baked_lighting(const Grid &grid, const std::string &path);
+
+void upload(BakedLighting &baked);
+void free_baked_lighting(BakedLighting &baked);
+
+// Multiplies world positions into texture coordinates of the volume.
+Vec3 bake_scale(const Grid &grid);
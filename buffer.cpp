@@ -1,42 +1,47 @@
 #include "buffer.h"
 
 #include "logging.h"
+#include "memory.h"
+#include "render_stats.h"
 #include "mesh2.h"
 #include <GL/glew.h>
 
+#include <cstring>
+
 template <typename T> long byte_size(const std::vector<T> &vector) {
     return vector.size() * sizeof(T);
 }
 
-std::vector<float> pack_vertices_and_normals(const std::vector<Vec3> &vertices,
-                                             const std::vector<Vec3> &normals) {
-    std::vector<float> data;
-    data.reserve(vertices.size() * 6);
-    for (int i = 0; i < vertices.size(); ++i) {
-        data.push_back(vertices[i].x);
-        data.push_back(vertices[i].y);
-        data.push_back(vertices[i].z);
-        data.push_back(normals[i].x);
-        data.push_back(normals[i].y);
-        data.push_back(normals[i].z);
+void pack_vertices_and_normals(const Mesh &mesh, float *data) {
+    for (int i = 0; i < mesh.vertices.size(); ++i) {
+        *data++ = mesh.vertices[i].x;
+        *data++ = mesh.vertices[i].y;
+        *data++ = mesh.vertices[i].z;
+        *data++ = mesh.normals[i].x;
+        *data++ = mesh.normals[i].y;
+        *data++ = mesh.normals[i].z;
     }
-    return data;
 }
 
+ShaderVariants &phong_shader() {
+    static ShaderVariants phong =
+        make_shader_variants("shaders/phong_vertex.glsl", "shaders/phong_fragment.glsl");
+    return phong;
+}
+
+// View, projection and viewer position come from the frame uniforms
 void draw(const BasicRenderingBuffer &buffer, const RenderingParameters &param) {
-    UseShader use(buffer.shader.program);
+    const Shader &shader = variant(phong_shader(), param.features);
+    UseShader use(shader.program);
     glBindVertexArray(buffer.VAO);
 
-    set_matrix4(buffer.shader, "model", param.model_transform);
-    set_matrix4(buffer.shader, "view", param.view_transform);
-    set_matrix4(buffer.shader, "projection", param.perspective_transform);
-    set_vec3(buffer.shader, "color", param.color);
-    set_vec3(buffer.shader, "viewer_pos", param.camera_position);
-    set_int(buffer.shader, "show_normals", param.show_normals);
-//    set_vec3(buffer.shader, "teleportation_target", param.teleportation_target);
-//    set_int(buffer.shader, "show_teleportation", param.show_teleportation);
+    set_matrix4(shader, "model", param.model_transform);
+    set_vec3(shader, "color", param.color);
+//    set_vec3(shader, "teleportation_target", param.teleportation_target);
 
     glDrawArrays(GL_TRIANGLES, 0, buffer.n_vertices);
+    render_stats().draw_calls++;
+    render_stats().triangles += buffer.n_vertices / 3;
     glBindVertexArray(0);
 }
 
@@ -77,11 +82,17 @@ void draw(const BasicRenderingBuffer &buffer, const RenderingParameters &param)
 // }
 
 BasicRenderingBuffer init_rendering(const Mesh &mesh) {
-    std::vector<float> data = pack_vertices_and_normals(mesh.vertices, mesh.normals);
+    MemoryScope scope(MemoryTag::Render);
+    std::vector<float> data(mesh.vertices.size() * floats_per_vertex);
+    pack_vertices_and_normals(mesh, data.data());
+    return init_rendering(data.data(), mesh.vertices.size());
+}
 
+BasicRenderingBuffer init_rendering(const float *packed, int n_vertices) {
+    MemoryScope scope(MemoryTag::Render);
     BasicRenderingBuffer buffer;
-    buffer.shader = compile("shaders/phong_vertex.glsl", "shaders/phong_fragment.glsl");
-    buffer.n_vertices = mesh.vertices.size();
+    buffer.n_vertices = n_vertices;
+    long size = n_vertices * floats_per_vertex * sizeof(float);
 
     glGenVertexArrays(1, &buffer.VAO);
     glGenBuffers(1, &buffer.VBO);
@@ -89,7 +100,14 @@ BasicRenderingBuffer init_rendering(const Mesh &mesh) {
 
     glBindVertexArray(buffer.VAO);
     glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
-    glBufferData(GL_ARRAY_BUFFER, byte_size(data), data.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    if (size > 0) {
+        void *mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        std::memcpy(mapped, packed, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    track_gpu_memory(MemoryTag::Render, size);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
@@ -98,6 +116,18 @@ BasicRenderingBuffer init_rendering(const Mesh &mesh) {
     return buffer;
 }
 
+void free_rendering(BasicRenderingBuffer &buffer) {
+    track_gpu_memory(MemoryTag::Render, -(int64_t)buffer.n_vertices * floats_per_vertex *
+                                            (int64_t)sizeof(float));
+    glDeleteBuffers(1, &buffer.VBO);
+    glDeleteBuffers(1, &buffer.VBO_face_indices);
+    glDeleteVertexArrays(1, &buffer.VAO);
+    buffer.VAO = 0;
+    buffer.VBO = 0;
+    buffer.VBO_face_indices = 0;
+    buffer.n_vertices = 0;
+}
+
 // Rectangle make_rectangle(float width, float height, float depth) {
 //     Rectangle rect;
 //     rect.width = width;
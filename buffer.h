@@ -9,7 +9,6 @@ struct BasicRenderingBuffer {
     unsigned int VAO{};
     unsigned int VBO{};
     unsigned int VBO_face_indices{};
-    Shader shader;
     int n_vertices{};
 };
 
@@ -19,7 +18,7 @@ struct RenderingParameters {
     Mat4 view_transform;
     Mat4 perspective_transform;
     Vec3 camera_position;
-    bool show_normals;
+    uint32_t features; // ShaderFeature, selects the variant of the phong program
 //    Vec3 teleportation_target;
 //    bool show_teleportation;
 };
@@ -39,9 +38,22 @@ struct RenderingParameters {
 //     BasicRenderingBuffer rendering;
 // };
 
+// Program of everything lit, the buffers do not hold their own.
+ShaderVariants &phong_shader();
+
 void draw(const BasicRenderingBuffer &buffer, const RenderingParameters &param);
 
+// Vertices are uploaded interleaved with their normals
+constexpr int floats_per_vertex = 6;
+
+// Writes mesh.vertices.size() * floats_per_vertex floats, so that meshes can be packed in
+// parallel in one preallocated array before the upload.
+void pack_vertices_and_normals(const Mesh &mesh, float *data);
+
 BasicRenderingBuffer init_rendering(const Mesh &mesh);
+// Only copies the already packed vertices to the GPU.
+BasicRenderingBuffer init_rendering(const float *packed, int n_vertices);
+void free_rendering(BasicRenderingBuffer &buffer);
 
 // void draw(const Rectangle &cube, const Camera &camera);
 
@@ -0,0 +1,58 @@
+#include "command_list.h"
+
+#include "memory.h"
+
+void clear(CommandList &list) {
+    list.commands.clear();
+    list.data.clear();
+    list.program = 0;
+    list.VAO = 0;
+    list.color_valid = false;
+    list.avoided = 0;
+}
+
+void bind_program(CommandList &list, uint32_t program) {
+    if (list.program == program) {
+        list.avoided++;
+        return;
+    }
+    MemoryScope scope(MemoryTag::Render);
+    list.commands.push_back({.type = CommandType::BindProgram, .handle = program});
+    list.program = program;
+    // Uniforms belong to the program
+    list.color_valid = false;
+}
+
+void bind_vertex_array(CommandList &list, uint32_t VAO) {
+    if (list.VAO == VAO) {
+        list.avoided++;
+        return;
+    }
+    MemoryScope scope(MemoryTag::Render);
+    list.commands.push_back({.type = CommandType::BindVertexArray, .handle = VAO});
+    list.VAO = VAO;
+}
+
+void set_model(CommandList &list, const Mat4 &model) {
+    MemoryScope scope(MemoryTag::Render);
+    list.commands.push_back({.type = CommandType::SetModel, .first = (int)list.data.size()});
+    list.data.insert(list.data.end(), model.ptr(), model.ptr() + 16);
+}
+
+void set_color(CommandList &list, Vec3 color) {
+    if (list.color_valid && color.x == list.color.x && color.y == list.color.y &&
+        color.z == list.color.z) {
+        list.avoided++;
+        return;
+    }
+    MemoryScope scope(MemoryTag::Render);
+    list.commands.push_back({.type = CommandType::SetColor, .first = (int)list.data.size()});
+    list.data.insert(list.data.end(), {color.x, color.y, color.z});
+    list.color = color;
+    list.color_valid = true;
+}
+
+void draw(CommandList &list, int first, int count) {
+    MemoryScope scope(MemoryTag::Render);
+    list.commands.push_back({.type = CommandType::Draw, .first = first, .count = count});
+}
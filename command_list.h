@@ -0,0 +1,57 @@
+#pragma once
+
+#include "maths.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Draw commands recorded without calling GL, so that worker threads can fill one list each for
+// disjoint parts of the scene. Binds and colors that would not change anything are left out while
+// recording, the GL thread replays the lists as they are. Programs and vertex arrays are opaque
+// handles to the list.
+
+enum class CommandType : uint8_t { BindProgram, BindVertexArray, SetModel, SetColor, Draw };
+
+struct Command {
+    CommandType type;
+    uint32_t handle; // program or vertex array
+    int first;       // of the vertices to draw, or of the uniform values in data
+    int count;       // vertices to draw
+};
+
+struct CommandList {
+    std::vector<Command> commands;
+    std::vector<float> data; // uniform values
+    // What the recorded commands have bound so far
+    uint32_t program = 0;
+    uint32_t VAO = 0;
+    bool color_valid = false;
+    Vec3 color;
+    int avoided = 0; // commands left out
+};
+
+// Empties the list, keeping its memory.
+void clear(CommandList &list);
+
+void bind_program(CommandList &list, uint32_t program);
+void bind_vertex_array(CommandList &list, uint32_t VAO);
+void set_model(CommandList &list, const Mat4 &model);
+void set_color(CommandList &list, Vec3 color);
+void draw(CommandList &list, int first, int count);
+
+// GL backend, in command_list_gl.cpp
+
+struct ProgramUniforms {
+    int model;
+    int color;
+};
+
+struct CommandBackend {
+    std::unordered_map<uint32_t, ProgramUniforms> uniforms;
+};
+
+// Executes the list on the GL thread, the frame uniforms must be bound. Lists can be replayed one
+// after the other, finish_replay unbinds what the last one left bound.
+void replay(CommandBackend &backend, const CommandList &list);
+void finish_replay(CommandBackend &backend);
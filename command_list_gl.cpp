@@ -0,0 +1,54 @@
+#include "command_list.h"
+
+#include "memory.h"
+#include "render_stats.h"
+
+#include <GL/glew.h>
+
+const ProgramUniforms &uniforms_of(CommandBackend &backend, uint32_t program) {
+    auto it = backend.uniforms.find(program);
+    if (it == backend.uniforms.end()) {
+        MemoryScope scope(MemoryTag::Render);
+        ProgramUniforms u = {.model = glGetUniformLocation(program, "model"),
+                             .color = glGetUniformLocation(program, "color")};
+        it = backend.uniforms.emplace(program, u).first;
+    }
+    return it->second;
+}
+
+// Lists always bind a program before setting uniforms, there is no other check
+void replay(CommandBackend &backend, const CommandList &list) {
+    const ProgramUniforms *u = nullptr;
+    render_stats().state_changes_avoided += list.avoided;
+    for (const Command &command : list.commands) {
+        switch (command.type) {
+        case CommandType::BindProgram:
+            glUseProgram(command.handle);
+            u = &uniforms_of(backend, command.handle);
+            render_stats().state_changes++;
+            break;
+        case CommandType::BindVertexArray:
+            glBindVertexArray(command.handle);
+            render_stats().state_changes++;
+            break;
+        case CommandType::SetModel:
+            glUniformMatrix4fv(u->model, 1, GL_TRUE, &list.data[command.first]);
+            render_stats().uniform_uploads++;
+            break;
+        case CommandType::SetColor:
+            glUniform3fv(u->color, 1, &list.data[command.first]);
+            render_stats().uniform_uploads++;
+            break;
+        case CommandType::Draw:
+            glDrawArrays(GL_TRIANGLES, command.first, command.count);
+            render_stats().draw_calls++;
+            render_stats().triangles += command.count / 3;
+            break;
+        }
+    }
+}
+
+void finish_replay(CommandBackend &backend) {
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
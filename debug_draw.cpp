@@ -0,0 +1,109 @@
+#include "debug_draw.h"
+
+#include "memory.h"
+#include "render_stats.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+constexpr int floats_per_debug_vertex = sizeof(DebugVertex) / sizeof(float);
+
+DebugDraw make_debug_draw() {
+    MemoryScope scope(MemoryTag::Render);
+    DebugDraw debug;
+    debug.shader = compile("shaders/debug_vertex.glsl", "shaders/debug_fragment.glsl");
+
+    // The attributes point to the stream buffer, at a different offset each frame
+    glGenVertexArrays(1, &debug.VAO);
+    glBindVertexArray(debug.VAO);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    return debug;
+}
+
+void free_debug_draw(DebugDraw &debug) {
+    glDeleteVertexArrays(1, &debug.VAO);
+    debug = DebugDraw{};
+}
+
+void line(DebugDraw &debug, Vec3 a, Vec3 b, Vec3 color) {
+    MemoryScope scope(MemoryTag::Render);
+    debug.lines.push_back({a.x, a.y, a.z, 1, color.x, color.y, color.z, 1});
+    debug.lines.push_back({b.x, b.y, b.z, 1, color.x, color.y, color.z, 1});
+}
+
+void point(DebugDraw &debug, Vec3 p, Vec3 color, float size) {
+    MemoryScope scope(MemoryTag::Render);
+    debug.points.push_back({p.x, p.y, p.z, 1, color.x, color.y, color.z, size});
+}
+
+void screen_point(DebugDraw &debug, float x, float y, Vec3 color, float size) {
+    MemoryScope scope(MemoryTag::Render);
+    debug.points.push_back({x, y, 0, 0, color.x, color.y, color.z, size});
+}
+
+void aabb(DebugDraw &debug, Vec3 min, Vec3 max, Vec3 color) {
+    Vec3 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        corners[i] = {(i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z};
+    }
+    // Corners that differ by one bit share an edge
+    for (int i = 0; i < 8; ++i) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) {
+                line(debug, corners[i], corners[i | bit], color);
+            }
+        }
+    }
+}
+
+void ray(DebugDraw &debug, const Ray &ray, float length, Vec3 color) {
+    line(debug, ray.origin, ray.origin + ray.direction * length, color);
+    point(debug, ray.origin, color);
+}
+
+void flush(DebugDraw &debug, StreamBuffer &stream) {
+    int n_lines = debug.lines.size();
+    int n_points = debug.points.size();
+    if (n_lines + n_points == 0) {
+        return;
+    }
+
+    StreamAllocation allocation = allocate(stream, (n_lines + n_points) * sizeof(DebugVertex));
+    if (!allocation.data) {
+        debug.lines.clear();
+        debug.points.clear();
+        return;
+    }
+    auto *vertices = (DebugVertex *)allocation.data;
+    std::copy(debug.lines.begin(), debug.lines.end(), vertices);
+    std::copy(debug.points.begin(), debug.points.end(), vertices + n_lines);
+    commit(stream, allocation);
+
+    UseShader use(debug.shader.program);
+    glBindVertexArray(debug.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    int stride = sizeof(DebugVertex);
+    auto *base = (char *)allocation.offset;
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, base);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, base + 4 * sizeof(float));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (n_lines > 0) {
+        glDrawArrays(GL_LINES, 0, n_lines);
+        render_stats().draw_calls++;
+    }
+    if (n_points > 0) {
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glDrawArrays(GL_POINTS, n_lines, n_points);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+        render_stats().draw_calls++;
+    }
+    glBindVertexArray(0);
+
+    debug.lines.clear();
+    debug.points.clear();
+}
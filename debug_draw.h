@@ -0,0 +1,39 @@
+#pragma once
+
+#include "maths.h"
+#include "raycast.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+#include <vector>
+
+// Lines and points collected during the frame and drawn at once by flush, one draw call for the
+// lines and one for the points whatever their number. Positions are in world space, except
+// screen points which are in clip coordinates like a cursor.
+
+struct DebugVertex {
+    float x, y, z;
+    float world; // 1 in world space, 0 in clip space
+    float r, g, b;
+    float size; // of points, in pixels
+};
+
+struct DebugDraw {
+    unsigned int VAO{};
+    Shader shader;
+    std::vector<DebugVertex> lines;
+    std::vector<DebugVertex> points;
+};
+
+DebugDraw make_debug_draw();
+void free_debug_draw(DebugDraw &debug);
+
+void line(DebugDraw &debug, Vec3 a, Vec3 b, Vec3 color);
+void point(DebugDraw &debug, Vec3 p, Vec3 color, float size = 5);
+void screen_point(DebugDraw &debug, float x, float y, Vec3 color, float size = 5);
+void aabb(DebugDraw &debug, Vec3 min, Vec3 max, Vec3 color);
+void ray(DebugDraw &debug, const Ray &ray, float length, Vec3 color);
+
+// Draws everything added since the last flush and empties the lists, keeping their memory. The
+// vertices go through the stream buffer and the frame uniforms must be bound.
+void flush(DebugDraw &debug, StreamBuffer &stream);
@@ -0,0 +1,34 @@
+#include "frustum.h"
+
+#include <cmath>
+
+Frustum make_frustum(const Mat4 &m) {
+    auto row = [&](int i) { return Vec4{m.val(i, 0), m.val(i, 1), m.val(i, 2), m.val(i, 3)}; };
+    auto add = [](Vec4 a, Vec4 b, float sign) {
+        return Vec4{a.x + sign * b.x, a.y + sign * b.y, a.z + sign * b.z, a.w + sign * b.w};
+    };
+
+    Frustum frustum;
+    Vec4 w = row(3);
+    for (int axis = 0; axis < 3; ++axis) {
+        frustum.planes[axis * 2] = add(w, row(axis), 1);
+        frustum.planes[axis * 2 + 1] = add(w, row(axis), -1);
+    }
+    for (Vec4 &plane : frustum.planes) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = {plane.x / length, plane.y / length, plane.z / length, plane.w / length};
+    }
+    return frustum;
+}
+
+bool intersects(const Frustum &frustum, Vec3 min, Vec3 max) {
+    for (const Vec4 &plane : frustum.planes) {
+        // Corner of the box the furthest along the normal of the plane
+        Vec3 p = {plane.x > 0 ? max.x : min.x, plane.y > 0 ? max.y : min.y,
+                  plane.z > 0 ? max.z : min.z};
+        if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
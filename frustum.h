@@ -0,0 +1,15 @@
+#pragma once
+
+#include "maths.h"
+
+// Planes of the view frustum, pointing inside, from a projection * view matrix (Gribb & Hartmann,
+// "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix").
+struct Frustum {
+    Vec4 planes[6];
+};
+
+Frustum make_frustum(const Mat4 &projection_view);
+
+// False only when the box is entirely outside one of the planes, boxes near the corners can be
+// kept although they are not visible.
+bool intersects(const Frustum &frustum, Vec3 min, Vec3 max);
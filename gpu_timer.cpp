@@ -0,0 +1,92 @@
+#include "gpu_timer.h"
+
+#include <GL/glew.h>
+
+void init_gpu_timer(GpuTimer &timer) {
+    // llvmpipe has it too, so this also runs on machines without a GPU
+    timer.supported = GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+    if (!timer.supported) {
+        return;
+    }
+    for (auto &frame : timer.frames) {
+        glGenQueries(max_gpu_passes * 2, &frame.queries[0][0]);
+    }
+}
+
+void free_gpu_timer(GpuTimer &timer) {
+    if (!timer.supported) {
+        return;
+    }
+    for (auto &frame : timer.frames) {
+        glDeleteQueries(max_gpu_passes * 2, &frame.queries[0][0]);
+    }
+    timer.supported = false;
+}
+
+// Copies the timings of the frame if the GPU is done with it. Otherwise the frame is dropped,
+// waiting for it would stall the CPU.
+void read_back(GpuTimer &timer, GpuTimerFrame &frame) {
+    if (!frame.recorded || frame.n_passes == 0) {
+        return;
+    }
+    frame.recorded = false;
+
+    // Queries complete in order, the end of the frame is the last one
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[0][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;
+    }
+
+    for (int i = 0; i < frame.n_passes; ++i) {
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.queries[i][0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[i][1], GL_QUERY_RESULT, &end);
+        timer.results[i] = {.name = frame.names[i],
+                            .depth = frame.depths[i],
+                            .ms = (end - begin) / 1e6};
+    }
+    timer.n_results = frame.n_passes;
+}
+
+void begin_frame(GpuTimer &timer) {
+    if (!timer.supported) {
+        return;
+    }
+    timer.current = (timer.current + 1) % gpu_timer_frames;
+    GpuTimerFrame &frame = timer.frames[timer.current];
+    // The slot is reused, it was recorded gpu_timer_frames frames ago
+    read_back(timer, frame);
+    frame.n_passes = 0;
+    timer.depth = 0;
+    begin_pass(timer, "frame");
+}
+
+void end_frame(GpuTimer &timer) {
+    if (!timer.supported) {
+        return;
+    }
+    end_pass(timer, 0);
+    timer.frames[timer.current].recorded = true;
+}
+
+int begin_pass(GpuTimer &timer, const char *name) {
+    GpuTimerFrame &frame = timer.frames[timer.current];
+    if (!timer.supported || frame.n_passes == max_gpu_passes) {
+        return -1;
+    }
+    int pass = frame.n_passes++;
+    frame.names[pass] = name;
+    frame.depths[pass] = timer.depth++;
+    glQueryCounter(frame.queries[pass][0], GL_TIMESTAMP);
+    return pass;
+}
+
+void end_pass(GpuTimer &timer, int pass) {
+    if (pass < 0) {
+        return;
+    }
+    timer.depth--;
+    glQueryCounter(timer.frames[timer.current].queries[pass][1], GL_TIMESTAMP);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+// GPU time of the render passes, measured with GL_TIMESTAMP queries around each pass so that
+// passes can be nested. Results are read back gpu_timer_frames frames later, when the GPU is done
+// with them, instead of waiting for them at the end of the frame. Without ARB_timer_query (or GL
+// 3.3) nothing is measured and the results stay empty.
+
+constexpr int gpu_timer_frames = 4;
+constexpr int max_gpu_passes = 16;
+
+struct GpuPassTime {
+    const char *name;
+    int depth;
+    double ms;
+};
+
+struct GpuTimerFrame {
+    unsigned int queries[max_gpu_passes][2]{}; // begin and end timestamps
+    const char *names[max_gpu_passes]{};
+    int depths[max_gpu_passes]{};
+    int n_passes = 0;
+    bool recorded = false;
+};
+
+struct GpuTimer {
+    bool supported = false;
+    GpuTimerFrame frames[gpu_timer_frames];
+    int current = 0;
+    int depth = 0;
+    // Last frame read back, the first pass is the whole frame
+    GpuPassTime results[max_gpu_passes];
+    int n_results = 0;
+};
+
+void init_gpu_timer(GpuTimer &timer);
+void free_gpu_timer(GpuTimer &timer);
+
+void begin_frame(GpuTimer &timer);
+void end_frame(GpuTimer &timer);
+
+// Returns the pass to give to end_pass, -1 when it is not measured
+int begin_pass(GpuTimer &timer, const char *name);
+void end_pass(GpuTimer &timer, int pass);
+
+// RAII marker around a render pass
+class GpuPass {
+  public:
+    GpuPass(GpuTimer &timer, const char *name) : m_timer(timer), m_pass(begin_pass(timer, name)) {}
+    ~GpuPass() { end_pass(m_timer, m_pass); }
+
+  private:
+    GpuTimer &m_timer;
+    int m_pass;
+};
@@ -0,0 +1,453 @@
+#include "grid.h"
+
+#include "parallel.h"
+#include "traversal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+Vec3 coord_at(const Grid &grid, int index) {
+    float row = std::floor(index / grid.cols);
+    float col = index % grid.cols;
+    Vec3 cell_origin = {0.5f, 0.f, -0.5f};
+    return Vec3{col, 0.f, -row} + cell_origin;
+}
+
+int index_at(const Grid &grid, int row, int col) { return row * grid.cols + col; }
+
+Vec3 coord_at(const Grid &grid, int row, int col) {
+    return coord_at(grid, index_at(grid, row, col));
+}
+
+int index_at(const Grid &grid, Vec3 coord) {
+    int col = std::floor(coord.x);
+    int row = std::floor(-coord.z);
+    return index_at(grid, row, col);
+}
+
+bool can_teleport_here(Cell::Type type) {
+    return (type == Cell::Type::Floor) || (type == Cell::Type::Start) || (type == Cell::Type::End);
+}
+
+Entity make_entity(Mesh mesh, Vec3 color) {
+    Entity body;
+    body.mesh = mesh;
+    body.color = color;
+    body.transform = eye();
+    body.origin = {0, 0, 0};
+    return body;
+}
+
+constexpr float wall_height = 5;
+constexpr float hedge_height = 0.5;
+constexpr float wall_thickness = 0.2;
+constexpr float platform_height = 0.5;
+constexpr float raised_platform_height = 2;
+
+Entity make_entity_from_cell(Cell::Type type, CellProperties prop, int cols, int rows) {
+    MemoryScope scope(MemoryTag::Mesh);
+    switch (type) {
+    case Cell::Type::Floor:
+    case Cell::Type::Start:
+        return make_entity(floor_tile_mesh(cols, rows), {0.1, 0.8, 0.1});
+    case Cell::Type::End:
+        return make_entity(floor_tile_mesh(cols, rows), {0.1, 0.4, 0.5});
+    case Cell::Type::Wall: {
+        if (prop.axis == 0) {
+            return make_entity(rectangle_mesh(cols, wall_height, wall_thickness));
+        } else {
+            return make_entity(rectangle_mesh(wall_thickness, wall_height, rows));
+        }
+    }
+    case Cell::Type::Hedge: {
+        if (prop.axis == 0) {
+            return make_entity(rectangle_mesh(cols, hedge_height, wall_thickness), {0.1, 0.5, 0.1});
+        } else if (prop.axis == 2) {
+            return make_entity(rectangle_mesh(wall_thickness, hedge_height, rows), {0.1, 0.5, 0.1});
+        }
+    }
+    case Cell::Type::Platform: {
+        return make_entity(rectangle_mesh(cols, platform_height, rows), {0.1, 0.1, 0.8});
+    }
+    case Cell::Type::RaisedPlatform: {
+        return make_entity(rectangle_mesh(cols, raised_platform_height, rows), {0.1, 0.1, 0.8});
+    }
+    }
+}
+
+Cell make_cell(const Grid &grid, int row, int col, Cell::Type type, CellProperties prop) {
+    Entity entity = make_entity_from_cell(type, prop);
+    entity.transform = translate(eye(), coord_at(grid, row, col));
+    return {
+        .type = type,
+        .prop = prop,
+        .entity = entity,
+    };
+}
+
+void add_cell(Grid &grid, int row, int col, Cell::Type type, CellProperties prop) {
+    MemoryScope scope(MemoryTag::Grid);
+    grid.cells[index_at(grid, row, col)] = make_cell(grid, row, col, type, prop);
+
+    if (grid.heightfield.rows == grid.rows && grid.heightfield.cols == grid.cols) {
+        update_heightfield(grid, row, col);
+    }
+}
+
+float cell_height(const Cell &cell, float u, float v) {
+    switch (cell.type) {
+    case Cell::Type::Platform:
+        return platform_height;
+    case Cell::Type::RaisedPlatform:
+        return raised_platform_height;
+    case Cell::Type::Wall:
+    case Cell::Type::Hedge: {
+        // Walls and hedges are a thin slab in the middle of the cell, the rest is ground
+        float across = cell.prop.axis == 0 ? v : u;
+        if (std::abs(across - 0.5f) > wall_thickness / 2) {
+            return 0.f;
+        }
+        return cell.type == Cell::Type::Wall ? wall_height : hedge_height;
+    }
+    default:
+        return 0.f;
+    }
+}
+
+void update_heightfield(Grid &grid, int row, int col) {
+    const Cell &cell = grid.cells[index_at(grid, row, col)];
+    set_cell(grid.heightfield, row, col, [&](float u, float v) { return cell_height(cell, u, v); });
+}
+
+void build_heightfield(Grid &grid, int resolution) {
+    MemoryScope scope(MemoryTag::Grid);
+    resize(grid.heightfield, grid.rows, grid.cols, resolution);
+    for (int row = 0; row < grid.rows; ++row) {
+        for (int col = 0; col < grid.cols; ++col) {
+            update_heightfield(grid, row, col);
+        }
+    }
+}
+
+bool is_wall_like(Cell::Type type) { return type == Cell::Type::Wall || type == Cell::Type::Hedge; }
+
+bool merges_along_cols(const Cell &cell) {
+    return !is_wall_like(cell.type) || cell.prop.axis == 0;
+}
+
+bool merges_along_rows(const Cell &cell) {
+    return !is_wall_like(cell.type) || cell.prop.axis != 0;
+}
+
+bool same_kind(const Cell &a, const Cell &b) {
+    return a.type == b.type && (!is_wall_like(a.type) || a.prop.axis == b.prop.axis);
+}
+
+bool same_block(const GridBlock &a, const GridBlock &b) {
+    return a.type == b.type && a.prop.axis == b.prop.axis && a.row == b.row && a.col == b.col &&
+           a.rows == b.rows && a.cols == b.cols;
+}
+
+void compute_bounds(GridBlock &block) {
+    block.min = Vec3{1.f, 1.f, 1.f} * std::numeric_limits<float>::max();
+    block.max = Vec3{1.f, 1.f, 1.f} * std::numeric_limits<float>::lowest();
+    for (const Vec3 &vertex : block.entity.mesh.vertices) {
+        Vec3 v = block.entity.transform * vertex;
+        block.min = {std::min(block.min.x, v.x), std::min(block.min.y, v.y),
+                     std::min(block.min.z, v.z)};
+        block.max = {std::max(block.max.x, v.x), std::max(block.max.y, v.y),
+                     std::max(block.max.z, v.z)};
+    }
+}
+
+std::vector<GridBlock> greedy_blocks(const Grid &grid) {
+    std::vector<GridBlock> blocks;
+    std::vector<bool> merged(grid.cells.size(), false);
+    auto can_merge = [&](const Cell &cell, int row, int col) {
+        int index = index_at(grid, row, col);
+        return !merged[index] && same_kind(grid.cells[index], cell);
+    };
+
+    for (int row = 0; row < grid.rows; ++row) {
+        for (int col = 0; col < grid.cols; ++col) {
+            int index = index_at(grid, row, col);
+            if (merged[index]) {
+                continue;
+            }
+            const Cell &cell = grid.cells[index];
+
+            int cols = 1;
+            while (merges_along_cols(cell) && col + cols < grid.cols &&
+                   can_merge(cell, row, col + cols)) {
+                cols++;
+            }
+
+            int rows = 1;
+            while (merges_along_rows(cell) && row + rows < grid.rows) {
+                bool whole_row = true;
+                for (int c = col; c < col + cols && whole_row; ++c) {
+                    whole_row = can_merge(cell, row + rows, c);
+                }
+                if (!whole_row) {
+                    break;
+                }
+                rows++;
+            }
+
+            for (int r = row; r < row + rows; ++r) {
+                for (int c = col; c < col + cols; ++c) {
+                    merged[index_at(grid, r, c)] = true;
+                }
+            }
+            blocks.push_back({.type = cell.type,
+                              .prop = cell.prop,
+                              .row = row,
+                              .col = col,
+                              .rows = rows,
+                              .cols = cols});
+        }
+    }
+    return blocks;
+}
+
+void merge_cells(Grid &grid) {
+    MemoryScope scope(MemoryTag::Grid);
+    std::vector<GridBlock> new_blocks = greedy_blocks(grid);
+
+    std::unordered_map<int, int> previous;
+    for (const auto &[id, block] : grid.blocks) {
+        previous[index_at(grid, block.row, block.col)] = id;
+    }
+
+    // Keep the blocks that did not change, the others are replaced
+    std::vector<int> ids(new_blocks.size(), -1);
+    BlockMap blocks;
+    for (int i = 0; i < new_blocks.size(); ++i) {
+        auto it = previous.find(index_at(grid, new_blocks[i].row, new_blocks[i].col));
+        if (it != previous.end() && same_block(grid.blocks[it->second], new_blocks[i])) {
+            ids[i] = it->second;
+            blocks[ids[i]] = std::move(grid.blocks[ids[i]]);
+            grid.blocks.erase(ids[i]);
+        }
+    }
+
+    for (auto &[id, block] : grid.blocks) {
+        remove_mesh(grid.hidden_faces, id);
+        if (block.entity.rendering.VAO) {
+            free_rendering(block.entity.rendering);
+        }
+    }
+
+    // Meshes of the new blocks are independent, they are generated in parallel
+    std::vector<int> created;
+    for (int i = 0; i < new_blocks.size(); ++i) {
+        if (ids[i] < 0) {
+            created.push_back(i);
+        }
+    }
+    parallel_for(0, created.size(), [&](int k) {
+        GridBlock &block = new_blocks[created[k]];
+        Vec3 center = coord_at(grid, block.row, block.col) +
+                      Vec3{(block.cols - 1) / 2.f, 0.f, -(block.rows - 1) / 2.f};
+        block.entity = make_entity_from_cell(block.type, block.prop, block.cols, block.rows);
+        block.entity.transform = translate(eye(), center);
+        compute_bounds(block);
+    }, 16);
+    for (int i : created) {
+        ids[i] = grid.next_block_id++;
+        add_mesh(grid.hidden_faces, ids[i], new_blocks[i].entity.mesh,
+                 new_blocks[i].entity.transform);
+        blocks[ids[i]] = std::move(new_blocks[i]);
+    }
+    grid.blocks = std::move(blocks);
+
+    grid.cell_block.assign(grid.cells.size(), -1);
+    for (const auto &[id, block] : grid.blocks) {
+        for (int r = block.row; r < block.row + block.rows; ++r) {
+            for (int c = block.col; c < block.col + block.cols; ++c) {
+                grid.cell_block[index_at(grid, r, c)] = id;
+            }
+        }
+    }
+
+    // The faces shared between two blocks are never sent to the GPU. Visible meshes are packed
+    // in parallel into one array, the upload is then only copies on the GL thread.
+    std::vector<int> dirty = take_dirty(grid.hidden_faces);
+    std::vector<Mesh> visible(dirty.size());
+    parallel_for(0, dirty.size(), [&](int k) {
+        MemoryScope scope(MemoryTag::Mesh);
+        const Mesh &mesh = grid.blocks.at(dirty[k]).entity.mesh;
+        visible[k] = visible_mesh(grid.hidden_faces, dirty[k], mesh);
+    }, 16);
+
+    std::vector<long> offsets(dirty.size() + 1, 0);
+    for (int k = 0; k < dirty.size(); ++k) {
+        offsets[k + 1] = offsets[k] + visible[k].vertices.size() * floats_per_vertex;
+    }
+    std::vector<float> packed(offsets.back());
+    parallel_for(0, dirty.size(), [&](int k) {
+        pack_vertices_and_normals(visible[k], packed.data() + offsets[k]);
+    }, 16);
+
+    for (int k = 0; k < dirty.size(); ++k) {
+        Entity &entity = grid.blocks[dirty[k]].entity;
+        if (entity.rendering.VAO) {
+            free_rendering(entity.rendering);
+        }
+        entity.rendering = init_rendering(packed.data() + offsets[k], visible[k].vertices.size());
+    }
+
+    if (!created.empty() || !dirty.empty()) {
+        grid.version++;
+    }
+}
+
+void build_cell_triangles(Grid &grid) {
+    MemoryScope scope(MemoryTag::Grid);
+    grid.cell_triangles.resize(grid.cells.size() + 1);
+    grid.cell_triangles[0] = 0;
+    for (int i = 0; i < grid.cells.size(); ++i) {
+        int n = grid.cells[i].entity.mesh.vertices.size() / 3;
+        grid.cell_triangles[i + 1] = grid.cell_triangles[i] + n;
+    }
+
+    clear(grid.triangles);
+    resize(grid.triangles, grid.cell_triangles.back());
+    parallel_for(0, grid.cells.size(), [&](int i) {
+        const Entity &entity = grid.cells[i].entity;
+        const std::vector<Vec3> &vertices = entity.mesh.vertices;
+        for (int t = grid.cell_triangles[i]; t < grid.cell_triangles[i + 1]; ++t) {
+            int v = (t - grid.cell_triangles[i]) * 3;
+            set_triangle(grid.triangles, t, entity.transform * vertices[v],
+                         entity.transform * vertices[v + 1], entity.transform * vertices[v + 2], i);
+        }
+    });
+
+    MemoryScope physics_scope(MemoryTag::Physics);
+    clear(grid.collision);
+    for (int i = 0; i < size(grid.triangles); ++i) {
+        Vec3 v0 = {grid.triangles.v0x[i], grid.triangles.v0y[i], grid.triangles.v0z[i]};
+        Vec3 e1 = {grid.triangles.e1x[i], grid.triangles.e1y[i], grid.triangles.e1z[i]};
+        Vec3 e2 = {grid.triangles.e2x[i], grid.triangles.e2y[i], grid.triangles.e2z[i]};
+        add_triangle(grid.collision, v0, v0 + e1, v0 + e2);
+    }
+}
+
+RayHit raycast(const Grid &grid, const Ray &ray) {
+    return raycast(grid, ray, std::numeric_limits<float>::max());
+}
+
+RayHit raycast(const Grid &grid, const Ray &ray, float max_distance) {
+    RayHit hit;
+    traverse_cells(ray, grid.rows, grid.cols, max_distance, [&](int row, int col, float, float) {
+        int index = index_at(grid, row, col);
+        // the geometry of a cell stays inside the cell, the first hit is the nearest
+        hit = intersect(ray, grid.triangles, grid.cell_triangles[index],
+                        grid.cell_triangles[index + 1]);
+        return hit.triangle >= 0;
+    });
+    if (hit.t > max_distance) {
+        return RayHit{};
+    }
+    return hit;
+}
+
+void free_grid(Grid &grid) {
+    for (auto &[id, block] : grid.blocks) {
+        if (block.entity.rendering.VAO) {
+            free_rendering(block.entity.rendering);
+        }
+    }
+    grid = Grid{};
+}
+
+void update_grid(Grid &grid) {
+    merge_cells(grid);
+    build_cell_triangles(grid);
+    // add_cell keeps it up to date once it is built
+    if (grid.heightfield.rows != grid.rows || grid.heightfield.cols != grid.cols) {
+        build_heightfield(grid);
+    }
+}
+
+std::vector<CellDefinition> parse_definition(const std::string &def, int rows, int cols) {
+    if (def.size() < (size_t)rows * cols * 2) {
+        throw std::runtime_error("Definition of " + std::to_string(def.size() / 2) +
+                                 " cells is too short for " + std::to_string(rows) + "x" +
+                                 std::to_string(cols));
+    }
+    std::vector<CellDefinition> cells(rows * cols);
+    int starts = 0;
+    int ends = 0;
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col) {
+            int index = row * cols + col;
+            std::string s = def.substr(index * 2, 2);
+            auto parsed = [&](Cell::Type type, CellProperties prop = {}) {
+                cells[index].type = type;
+                cells[index].prop = prop;
+            };
+
+            if (s == "  ") {
+                parsed(Cell::Type::Floor);
+            } else if (s == "==") {
+                parsed(Cell::Type::Wall, {.axis = 0});
+            } else if (s == "||") {
+                parsed(Cell::Type::Wall, {.axis = 2});
+            } else if (s == "--") {
+                parsed(Cell::Type::Hedge, {.axis = 0});
+            } else if (s == "| ") {
+                parsed(Cell::Type::Hedge, {.axis = 2});
+            } else if (s == "TT") {
+                parsed(Cell::Type::RaisedPlatform);
+            } else if (s == "__") {
+                parsed(Cell::Type::Platform);
+            } else if (s == "a ") {
+                parsed(Cell::Type::Start);
+                starts++;
+            } else if (s == "z ") {
+                parsed(Cell::Type::End);
+                ends++;
+            } else {
+                throw std::runtime_error("Unknown cell: '" + s + "' at location (" +
+                                         std::to_string(row) + ", " + std::to_string(col) + ")");
+            }
+        }
+    }
+    if (starts != 1 || ends != 1) {
+        throw std::runtime_error("Levels need one start 'a' and one end 'z', got " +
+                                 std::to_string(starts) + " and " + std::to_string(ends));
+    }
+    return cells;
+}
+
+Grid make_grid_from_definition(std::string def, int rows, int cols) {
+    MemoryScope scope(MemoryTag::Grid);
+    Grid grid;
+    grid.rows = rows;
+    grid.cols = cols;
+    grid.cells.resize(rows * cols);
+
+    // Only the types first, errors are reported from this thread
+    std::vector<CellDefinition> cells = parse_definition(def, rows, cols);
+    for (int index = 0; index < rows * cols; ++index) {
+        grid.cells[index].type = cells[index].type;
+        grid.cells[index].prop = cells[index].prop;
+        if (cells[index].type == Cell::Type::Start) {
+            grid.start = index;
+        } else if (cells[index].type == Cell::Type::End) {
+            grid.end = index;
+        }
+    }
+
+    // Then the meshes of the cells, independently of each other
+    parallel_for(0, rows * cols, [&](int index) {
+        const Cell &cell = grid.cells[index];
+        grid.cells[index] = make_cell(grid, index / cols, index % cols, cell.type, cell.prop);
+    });
+
+    update_grid(grid);
+    return grid;
+}
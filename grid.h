@@ -0,0 +1,134 @@
+#pragma once
+
+#include "buffer.h"
+#include "heightfield.h"
+#include "hidden_faces.h"
+#include "maths.h"
+#include "memory.h"
+#include "mesh2.h"
+#include "physics.h"
+#include "raycast.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Entity {
+    Mesh mesh;
+    BasicRenderingBuffer rendering;
+    Vec3 color;
+    Mat4 transform;
+    Vec3 origin;
+};
+
+struct CellProperties {
+    int axis;
+};
+
+struct Cell {
+    enum Type {
+        Start,
+        End,
+        Floor,
+        Hole, // axis: X, Y or Z
+        Wall,
+        Mirror, // normal vector will define the orientation
+        Hedge,
+        Platform,
+        RaisedPlatform
+    };
+    Type type = Type::Floor;
+    CellProperties prop;
+    // Geometry of the cell alone, used for picking. Rendering goes through the merged blocks.
+    Entity entity;
+};
+
+// Rectangle of neighboring cells of the same type drawn as a single mesh.
+struct GridBlock {
+    Cell::Type type;
+    CellProperties prop;
+    int row;
+    int col;
+    int rows;
+    int cols;
+    Entity entity;
+    // Bounding box in world space
+    Vec3 min;
+    Vec3 max;
+};
+
+// Blocks come and go one at a time when cells are edited, their nodes come from a pool
+using BlockMap = std::unordered_map<int, GridBlock, std::hash<int>, std::equal_to<int>,
+                                    PoolAllocator<std::pair<const int, GridBlock>>>;
+
+struct Grid {
+    //    std::vector<Entity> entities;
+    std::vector<Cell> cells;
+    BlockMap blocks;
+    std::vector<int> cell_block;
+    int next_block_id = 0;
+    // Incremented each time the blocks or their visible faces change
+    int version = 0;
+    HiddenFaces hidden_faces;
+    // Triangles of every cell in world space, those of cell i are in
+    // [cell_triangles[i], cell_triangles[i + 1])
+    TriangleSoA triangles;
+    std::vector<int> cell_triangles;
+    CollisionWorld collision;
+    Heightfield heightfield;
+    int rows;
+    int cols;
+    int start;
+    int end;
+};
+
+Vec3 coord_at(const Grid &grid, int index);
+Vec3 coord_at(const Grid &grid, int row, int col);
+int index_at(const Grid &grid, int row, int col);
+int index_at(const Grid &grid, Vec3 coord);
+
+bool can_teleport_here(Cell::Type type);
+
+Entity make_entity(Mesh mesh, Vec3 color = {0.5, 0.5, 0.5});
+Entity make_entity_from_cell(Cell::Type type, CellProperties prop, int cols = 1, int rows = 1);
+
+// Only the cell, add_cell also updates the heightfield. Does not call GL.
+Cell make_cell(const Grid &grid, int row, int col, Cell::Type type, CellProperties prop);
+void add_cell(Grid &grid, int row, int col, Cell::Type type, CellProperties prop = {});
+
+// Greedy meshing: merges runs of cells of the same type into maximal rectangles. Floors and
+// platforms merge in both directions, walls and hedges only along their axis. Blocks that did not
+// change keep their GPU buffers, only new blocks and the ones whose hidden faces changed are
+// uploaded.
+void merge_cells(Grid &grid);
+
+void build_cell_triangles(Grid &grid);
+
+// Top of the geometry of the cell at (u, v) in [0, 1]^2 inside the cell, 0 on the ground.
+float cell_height(const Cell &cell, float u, float v);
+
+// Ground height used to place the player, cheaper than colliding with the triangles.
+void build_heightfield(Grid &grid, int resolution = 10);
+void update_heightfield(Grid &grid, int row, int col);
+
+// First cell geometry hit by the ray, id is the index of the cell. Only the cells crossed by the
+// ray are tested, up to the first one that is hit.
+RayHit raycast(const Grid &grid, const Ray &ray);
+// Only hits closer than max_distance, in units of the ray direction.
+RayHit raycast(const Grid &grid, const Ray &ray, float max_distance);
+
+// Recomputes everything derived from the cells, to call after changing them.
+void update_grid(Grid &grid);
+
+// Frees the GPU buffers of the blocks and empties the grid.
+void free_grid(Grid &grid);
+
+struct CellDefinition {
+    Cell::Type type;
+    CellProperties prop;
+};
+
+// Two characters per cell, throws on unknown cells or when there is not one start and one end.
+std::vector<CellDefinition> parse_definition(const std::string &def, int rows, int cols);
+
+Grid make_grid_from_definition(std::string def, int rows, int cols);
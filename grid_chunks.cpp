@@ -0,0 +1,71 @@
+#include "grid_chunks.h"
+
+#include "memory.h"
+#include "parallel.h"
+#include "render_stats.h"
+
+#include <algorithm>
+
+void update_grid_chunks(GridChunks &chunks, const Grid &grid) {
+    if (chunks.built_version == grid.version) {
+        return;
+    }
+    chunks.built_version = grid.version;
+    MemoryScope scope(MemoryTag::Render);
+    if (!chunks.workers) {
+        chunks.workers = std::make_unique<WorkerPool>();
+    }
+
+    int chunk_rows = (grid.rows + grid_chunk_size - 1) / grid_chunk_size;
+    int chunk_cols = (grid.cols + grid_chunk_size - 1) / grid_chunk_size;
+    chunks.chunks.resize(chunk_rows * chunk_cols);
+    for (GridChunk &chunk : chunks.chunks) {
+        chunk.blocks.clear();
+    }
+
+    // A block belongs to the chunk of its first cell, chunks are grown to the blocks they hold
+    for (const auto &[id, block] : grid.blocks) {
+        int index = block.row / grid_chunk_size * chunk_cols + block.col / grid_chunk_size;
+        GridChunk &chunk = chunks.chunks[index];
+        if (chunk.blocks.empty()) {
+            chunk.min = block.min;
+            chunk.max = block.max;
+        } else {
+            chunk.min = {std::min(chunk.min.x, block.min.x), std::min(chunk.min.y, block.min.y),
+                         std::min(chunk.min.z, block.min.z)};
+            chunk.max = {std::max(chunk.max.x, block.max.x), std::max(chunk.max.y, block.max.y),
+                         std::max(chunk.max.z, block.max.z)};
+        }
+        chunk.blocks.push_back(id);
+    }
+}
+
+void record(GridChunks &chunks, const Grid &grid, const Frustum &frustum, const Shader &shader) {
+    parallel_for(*chunks.workers, 0, chunks.chunks.size(), [&](int c) {
+        GridChunk &chunk = chunks.chunks[c];
+        clear(chunk.commands);
+        chunk.visible = 0;
+        if (chunk.blocks.empty() || !intersects(frustum, chunk.min, chunk.max)) {
+            return;
+        }
+        for (int id : chunk.blocks) {
+            const GridBlock &block = grid.blocks.at(id);
+            if (!intersects(frustum, block.min, block.max)) {
+                continue;
+            }
+            const Entity &entity = block.entity;
+            submit(chunk.queue, RenderPass::Opaque, shader, entity.rendering, entity.transform,
+                   entity.color);
+            chunk.visible++;
+        }
+        record(chunk.queue, chunk.commands);
+    }, 4);
+}
+
+void replay(CommandBackend &backend, const GridChunks &chunks) {
+    for (const GridChunk &chunk : chunks.chunks) {
+        replay(backend, chunk.commands);
+        render_stats().grid_blocks += chunk.visible;
+    }
+    finish_replay(backend);
+}
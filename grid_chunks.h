@@ -0,0 +1,39 @@
+#pragma once
+
+#include "command_list.h"
+#include "frustum.h"
+#include "grid.h"
+#include "parallel.h"
+#include "render_queue.h"
+
+#include <memory>
+#include <vector>
+
+// Blocks of the grid grouped by square chunks of cells. Each chunk is culled and recorded to its
+// own command list by a worker thread, the GL thread only replays the lists.
+
+constexpr int grid_chunk_size = 16;
+
+struct GridChunk {
+    std::vector<int> blocks;
+    // Bounding box of the blocks
+    Vec3 min;
+    Vec3 max;
+    RenderQueue queue;
+    CommandList commands;
+    int visible = 0; // blocks recorded this frame
+};
+
+struct GridChunks {
+    std::vector<GridChunk> chunks;
+    int built_version = -1;
+    std::unique_ptr<WorkerPool> workers; // started on the first update
+};
+
+// Groups the blocks again if the grid changed since the last call.
+void update_grid_chunks(GridChunks &chunks, const Grid &grid);
+
+// Culls and records every chunk in parallel on the workers, without calling GL.
+void record(GridChunks &chunks, const Grid &grid, const Frustum &frustum, const Shader &shader);
+
+void replay(CommandBackend &backend, const GridChunks &chunks);
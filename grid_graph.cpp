@@ -0,0 +1,210 @@
+#include "grid_graph.h"
+
+#include "logging.h"
+#include "memory.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Same as the camera, see Camera::set_position
+constexpr float eye_height = 1;
+
+// Candidates of one cell, kept between the cells of a thread
+struct LinkScratch {
+    std::vector<int> cells;
+    std::vector<float> heights;
+    std::vector<uint8_t> visible;
+};
+
+void link_cell(const Grid &grid, const OcclusionMap &occlusion, int index,
+               std::vector<int> &targets, LinkScratch &scratch) {
+    if (!can_teleport_here(grid.cells[index].type)) {
+        return;
+    }
+    int row = index / grid.cols;
+    int col = index % grid.cols;
+    scratch.cells.clear();
+    scratch.heights.clear();
+    for (int r = std::max(0, row - teleport_range);
+         r <= std::min(grid.rows - 1, row + teleport_range); ++r) {
+        for (int c = std::max(0, col - teleport_range);
+             c <= std::min(grid.cols - 1, col + teleport_range); ++c) {
+            int target = index_at(grid, r, c);
+            if (target != index && can_teleport_here(grid.cells[target].type)) {
+                scratch.cells.push_back(target);
+                scratch.heights.push_back(occlusion.heights[target]);
+            }
+        }
+    }
+
+    float eye = occlusion.heights[index] + eye_height;
+    line_of_sight(occlusion, index, eye, scratch.cells, scratch.heights, scratch.visible);
+    for (int i = 0; i < scratch.cells.size(); ++i) {
+        if (scratch.visible[i]) {
+            targets.push_back(scratch.cells[i]);
+        }
+    }
+}
+
+GridGraph make_grid_graph(const Grid &grid) {
+    MemoryScope scope(MemoryTag::Grid);
+    Timer timer;
+    GridGraph graph;
+    graph.rows = grid.rows;
+    graph.cols = grid.cols;
+    graph.occlusion = make_occlusion_map(grid);
+    int n = grid.rows * grid.cols;
+    graph.offsets.resize(n + 1);
+
+    // Bands of rows link their cells in their own vector, then the vectors are copied one after
+    // the other
+    constexpr int band_rows = 8;
+    int bands = (grid.rows + band_rows - 1) / band_rows;
+    std::vector<std::vector<int>> band_targets(bands);
+    parallel_for(0, bands, [&](int band) {
+        int first = band * band_rows * grid.cols;
+        int last = std::min(n, first + band_rows * grid.cols);
+        LinkScratch scratch;
+        for (int index = first; index < last; ++index) {
+            size_t before = band_targets[band].size();
+            link_cell(grid, graph.occlusion, index, band_targets[band], scratch);
+            graph.offsets[index + 1] = band_targets[band].size() - before;
+        }
+    }, 1);
+
+    for (int index = 0; index < n; ++index) {
+        graph.offsets[index + 1] += graph.offsets[index];
+    }
+    graph.targets.resize(graph.offsets[n]);
+    parallel_for(0, bands, [&](int band) {
+        std::copy(band_targets[band].begin(), band_targets[band].end(),
+                  graph.targets.begin() + graph.offsets[band * band_rows * grid.cols]);
+    }, 1);
+
+    compute_distances(graph, grid.end);
+    log("linked " + std::to_string(graph.targets.size()) + " teleports in " +
+        std::to_string(timer.seconds_elapsed()) + " s");
+    return graph;
+}
+
+void update_grid_graph(GridGraph &graph, const Grid &grid, const std::vector<int> &changed) {
+    MemoryScope scope(MemoryTag::Grid);
+    int n = grid.rows * grid.cols;
+    for (int index : changed) {
+        update_occlusion_map(graph.occlusion, grid, index);
+    }
+    // A link only looks at cells up to teleport_range away from where it starts
+    std::vector<bool> affected(n, false);
+    std::vector<int> sources;
+    for (int index : changed) {
+        int row = index / grid.cols;
+        int col = index % grid.cols;
+        for (int r = std::max(0, row - teleport_range);
+             r <= std::min(grid.rows - 1, row + teleport_range); ++r) {
+            for (int c = std::max(0, col - teleport_range);
+                 c <= std::min(grid.cols - 1, col + teleport_range); ++c) {
+                int source = index_at(grid, r, c);
+                if (!affected[source]) {
+                    affected[source] = true;
+                    sources.push_back(source);
+                }
+            }
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+
+    std::vector<std::vector<int>> relinked(sources.size());
+    parallel_for(0, sources.size(), [&](int i) {
+        thread_local LinkScratch scratch;
+        link_cell(grid, graph.occlusion, sources[i], relinked[i], scratch);
+    }, 16);
+
+    // Unchanged cells keep their links, in the same order
+    std::vector<int> offsets(n + 1, 0);
+    std::vector<int> targets;
+    targets.reserve(graph.targets.size());
+    int next = 0;
+    for (int index = 0; index < n; ++index) {
+        if (next < sources.size() && sources[next] == index) {
+            targets.insert(targets.end(), relinked[next].begin(), relinked[next].end());
+            ++next;
+        } else {
+            targets.insert(targets.end(), graph.targets.begin() + graph.offsets[index],
+                           graph.targets.begin() + graph.offsets[index + 1]);
+        }
+        offsets[index + 1] = targets.size();
+    }
+    graph.offsets = std::move(offsets);
+    graph.targets = std::move(targets);
+    compute_distances(graph, grid.end);
+}
+
+void compute_distances(GridGraph &graph, int goal) {
+    MemoryScope scope(MemoryTag::Grid);
+    int n = graph.rows * graph.cols;
+
+    // Links reversed, the search goes from the goal to the cells that can teleport to it
+    std::vector<int> offsets(n + 1, 0);
+    std::vector<int> sources(graph.targets.size());
+    for (int target : graph.targets) {
+        offsets[target + 1]++;
+    }
+    for (int index = 0; index < n; ++index) {
+        offsets[index + 1] += offsets[index];
+    }
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int index = 0; index < n; ++index) {
+        for (int i = graph.offsets[index]; i < graph.offsets[index + 1]; ++i) {
+            sources[fill[graph.targets[i]]++] = index;
+        }
+    }
+
+    graph.distance.assign(n, -1);
+    if (goal < 0 || goal >= n) {
+        return;
+    }
+    graph.distance[goal] = 0;
+    std::vector<int> frontier = {goal};
+    for (int level = 1; !frontier.empty(); ++level) {
+        // Cells are claimed with a compare and swap, each chunk of the frontier keeps the ones it
+        // claimed for the next frontier
+        int chunks = std::min<int>(worker_count(), frontier.size() / 256 + 1);
+        std::vector<std::vector<int>> claimed(chunks);
+        parallel_for(0, chunks, [&](int chunk) {
+            int from = (long)frontier.size() * chunk / chunks;
+            int to = (long)frontier.size() * (chunk + 1) / chunks;
+            for (int i = from; i < to; ++i) {
+                int cell = frontier[i];
+                for (int j = offsets[cell]; j < offsets[cell + 1]; ++j) {
+                    std::atomic_ref<int> distance(graph.distance[sources[j]]);
+                    int unreached = -1;
+                    if (distance.load(std::memory_order_relaxed) == -1 &&
+                        distance.compare_exchange_strong(unreached, level,
+                                                         std::memory_order_relaxed)) {
+                        claimed[chunk].push_back(sources[j]);
+                    }
+                }
+            }
+        }, 1);
+
+        frontier.clear();
+        for (const std::vector<int> &cells : claimed) {
+            frontier.insert(frontier.end(), cells.begin(), cells.end());
+        }
+    }
+}
+
+int next_teleport(const GridGraph &graph, int from) {
+    int distance = graph.distance[from];
+    if (distance <= 0) {
+        return -1;
+    }
+    for (int i = graph.offsets[from]; i < graph.offsets[from + 1]; ++i) {
+        if (graph.distance[graph.targets[i]] == distance - 1) {
+            return graph.targets[i];
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "grid.h"
+#include "line_of_sight.h"
+
+#include <vector>
+
+// Which cells can be teleported to from which, and how many teleports are left to reach the end
+// from every cell. A cell can be teleported to when there is a line of sight to it from the eye of
+// the player standing on another one and can_teleport_here allows it. Only cells up to
+// teleport_range away are linked, the game does not limit the distance but the graph stays small.
+// Like the line of sight, the graph is conservative: a level that can be finished in the graph can
+// be finished in the game.
+
+constexpr int teleport_range = 6; // in cells along rows and columns
+
+struct GridGraph {
+    int rows = 0;
+    int cols = 0;
+    OcclusionMap occlusion;
+    // The cells that can be teleported to from cell i are targets[offsets[i]] to
+    // targets[offsets[i + 1] - 1]
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    // Teleports from each cell to the end, -1 when it cannot be reached
+    std::vector<int> distance;
+};
+
+// Links every cell in parallel, then computes the distances to grid.end.
+GridGraph make_grid_graph(const Grid &grid);
+
+// Links again only the cells that can see one of the changed cells, to call once the grid is
+// updated after an edit.
+void update_grid_graph(GridGraph &graph, const Grid &grid, const std::vector<int> &changed);
+
+// Breadth first search from the goal on the reversed links, one frontier at a time with the
+// frontier split between threads.
+void compute_distances(GridGraph &graph, int goal);
+
+// Next cell on a shortest way to the end, -1 when the end cannot be reached or from is the end.
+int next_teleport(const GridGraph &graph, int from);
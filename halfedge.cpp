@@ -0,0 +1,146 @@
+#include "halfedge.h"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+// Vertices closer than this are the same vertex
+constexpr float weld_quantization = 1024.f;
+
+struct PositionKey {
+    int64_t x, y, z;
+};
+
+bool operator==(const PositionKey &a, const PositionKey &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey &key) const {
+        size_t h = 0;
+        for (int64_t v : {key.x, key.y, key.z}) {
+            h = h * 0x9e3779b1u + std::hash<int64_t>{}(v);
+        }
+        return h;
+    }
+};
+
+PositionKey position_key(Vec3 p) {
+    auto q = [](float v) { return (int64_t)std::llround((double)v * weld_quantization); };
+    return {q(p.x), q(p.y), q(p.z)};
+}
+
+uint64_t edge_key(int from, int to) { return ((uint64_t)(uint32_t)from << 32) | (uint32_t)to; }
+
+HalfEdgeMesh make_halfedge_mesh(const Mesh &mesh) {
+    HalfEdgeMesh he;
+    int n_halfedges = mesh.vertices.size() / 3 * 3;
+    he.halfedge_vertex.resize(n_halfedges);
+    he.halfedge_twin.assign(n_halfedges, -1);
+
+    std::unordered_map<PositionKey, int, PositionKeyHash> vertex_ids;
+    vertex_ids.reserve(n_halfedges);
+    for (int h = 0; h < n_halfedges; ++h) {
+        auto [it, inserted] =
+            vertex_ids.try_emplace(position_key(mesh.vertices[h]), he.positions.size());
+        if (inserted) {
+            he.positions.push_back(mesh.vertices[h]);
+        }
+        he.halfedge_vertex[h] = it->second;
+    }
+
+    // Pair each half-edge with the first unpaired one going the other way
+    std::unordered_map<uint64_t, int> unpaired;
+    unpaired.reserve(n_halfedges);
+    for (int h = 0; h < n_halfedges; ++h) {
+        int from = he.halfedge_vertex[h];
+        int to = he.halfedge_vertex[next(h)];
+        auto it = unpaired.find(edge_key(to, from));
+        if (it != unpaired.end()) {
+            he.halfedge_twin[h] = it->second;
+            he.halfedge_twin[it->second] = h;
+            unpaired.erase(it);
+        } else {
+            unpaired.emplace(edge_key(from, to), h);
+        }
+    }
+
+    he.vertex_halfedge.assign(he.positions.size(), -1);
+    for (int h = 0; h < n_halfedges; ++h) {
+        int &outgoing = he.vertex_halfedge[he.halfedge_vertex[h]];
+        if (outgoing < 0 || he.halfedge_twin[h] < 0) {
+            outgoing = h;
+        }
+    }
+    return he;
+}
+
+int n_faces(const HalfEdgeMesh &mesh) { return mesh.halfedge_vertex.size() / 3; }
+
+int n_vertices(const HalfEdgeMesh &mesh) { return mesh.positions.size(); }
+
+int origin(const HalfEdgeMesh &mesh, int halfedge) { return mesh.halfedge_vertex[halfedge]; }
+
+int target(const HalfEdgeMesh &mesh, int halfedge) { return mesh.halfedge_vertex[next(halfedge)]; }
+
+int twin(const HalfEdgeMesh &mesh, int halfedge) { return mesh.halfedge_twin[halfedge]; }
+
+int face_neighbor(const HalfEdgeMesh &mesh, int face, int k) {
+    int t = mesh.halfedge_twin[face * 3 + k];
+    return t < 0 ? -1 : face_of(t);
+}
+
+std::array<int, 3> face_neighbors(const HalfEdgeMesh &mesh, int face) {
+    return {face_neighbor(mesh, face, 0), face_neighbor(mesh, face, 1),
+            face_neighbor(mesh, face, 2)};
+}
+
+int shared_edge(const HalfEdgeMesh &mesh, int face_a, int face_b) {
+    for (int k = 0; k < 3; ++k) {
+        if (face_neighbor(mesh, face_a, k) == face_b) {
+            return face_a * 3 + k;
+        }
+    }
+    return -1;
+}
+
+std::vector<int> vertex_ring(const HalfEdgeMesh &mesh, int vertex) {
+    std::vector<int> ring;
+    int start = mesh.vertex_halfedge[vertex];
+    if (start < 0) {
+        return ring;
+    }
+
+    // Rotate around the vertex through the twin of the incoming half-edge of each face. Starting
+    // from the boundary half-edge makes sure we see all the faces before reaching the other side.
+    int h = start;
+    do {
+        ring.push_back(target(mesh, h));
+        int incoming = prev(h);
+        h = mesh.halfedge_twin[incoming];
+        if (h < 0) {
+            ring.push_back(origin(mesh, incoming));
+            break;
+        }
+    } while (h != start);
+    return ring;
+}
+
+bool is_boundary_edge(const HalfEdgeMesh &mesh, int halfedge) {
+    return mesh.halfedge_twin[halfedge] < 0;
+}
+
+bool is_boundary_vertex(const HalfEdgeMesh &mesh, int vertex) {
+    int h = mesh.vertex_halfedge[vertex];
+    return h >= 0 && mesh.halfedge_twin[h] < 0;
+}
+
+std::vector<int> boundary_edges(const HalfEdgeMesh &mesh) {
+    std::vector<int> edges;
+    for (int h = 0; h < mesh.halfedge_twin.size(); ++h) {
+        if (mesh.halfedge_twin[h] < 0) {
+            edges.push_back(h);
+        }
+    }
+    return edges;
+}
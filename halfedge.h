@@ -0,0 +1,48 @@
+#pragma once
+
+#include "maths.h"
+#include "mesh2.h"
+
+#include <array>
+#include <vector>
+
+// Half-edge connectivity for a Mesh, built in linear time.
+//
+// Vertices with the same position are welded together. Faces keep the order of the Mesh, and the
+// three half-edges of face f are 3f, 3f + 1 and 3f + 2, so the face, next and previous half-edges
+// are computed from the index and only the twins need to be stored. A twin of -1 means the edge is
+// on the boundary of the mesh.
+
+struct HalfEdgeMesh {
+    std::vector<Vec3> positions;
+    std::vector<int> vertex_halfedge; // one outgoing half-edge, on the boundary if there is one
+    std::vector<int> halfedge_vertex; // vertex the half-edge starts from
+    std::vector<int> halfedge_twin;
+};
+
+HalfEdgeMesh make_halfedge_mesh(const Mesh &mesh);
+
+inline int face_of(int halfedge) { return halfedge / 3; }
+inline int next(int halfedge) { return halfedge - halfedge % 3 + (halfedge + 1) % 3; }
+inline int prev(int halfedge) { return halfedge - halfedge % 3 + (halfedge + 2) % 3; }
+
+int n_faces(const HalfEdgeMesh &mesh);
+int n_vertices(const HalfEdgeMesh &mesh);
+
+int origin(const HalfEdgeMesh &mesh, int halfedge);
+int target(const HalfEdgeMesh &mesh, int halfedge);
+int twin(const HalfEdgeMesh &mesh, int halfedge);
+
+// Face on the other side of the k-th edge of the face, -1 on the boundary.
+int face_neighbor(const HalfEdgeMesh &mesh, int face, int k);
+std::array<int, 3> face_neighbors(const HalfEdgeMesh &mesh, int face);
+
+// Half-edge of face a along the edge shared with face b, -1 if they are not neighbors.
+int shared_edge(const HalfEdgeMesh &mesh, int face_a, int face_b);
+
+// Neighbors of the vertex, in order around it.
+std::vector<int> vertex_ring(const HalfEdgeMesh &mesh, int vertex);
+
+bool is_boundary_edge(const HalfEdgeMesh &mesh, int halfedge);
+bool is_boundary_vertex(const HalfEdgeMesh &mesh, int vertex);
+std::vector<int> boundary_edges(const HalfEdgeMesh &mesh);
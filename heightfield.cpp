@@ -0,0 +1,61 @@
+#include "heightfield.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void resize(Heightfield &field, int rows, int cols, int resolution) {
+    field.rows = rows;
+    field.cols = cols;
+    field.resolution = resolution;
+    field.heights.assign(rows * resolution * cols * resolution, 0.f);
+}
+
+float height_at(const Heightfield &field, float x, float z) {
+    int width = field.cols * field.resolution;
+    int depth = field.rows * field.resolution;
+    if (width == 0 || depth == 0) {
+        return 0.f;
+    }
+
+    // In units of samples, from the center of the first one
+    float u = std::clamp(x * field.resolution - 0.5f, 0.f, width - 1.f);
+    float v = std::clamp(-z * field.resolution - 0.5f, 0.f, depth - 1.f);
+    int i0 = u;
+    int j0 = v;
+    int i1 = std::min(i0 + 1, width - 1);
+    int j1 = std::min(j0 + 1, depth - 1);
+    float fu = u - i0;
+    float fv = v - j0;
+
+    const float *row0 = &field.heights[j0 * width];
+    const float *row1 = &field.heights[j1 * width];
+    float h0 = row0[i0] + (row0[i1] - row0[i0]) * fu;
+    float h1 = row1[i0] + (row1[i1] - row1[i0]) * fu;
+    return h0 + (h1 - h0) * fv;
+}
+
+float height_at(const Heightfield &field, Vec3 position) {
+    return height_at(field, position.x, position.z);
+}
+
+float highest_ground(const Heightfield &field, float min_x, float max_x, float min_z, float max_z,
+                     float max_height) {
+    int width = field.cols * field.resolution;
+    int depth = field.rows * field.resolution;
+    // Samples whose center is in the box
+    int i0 = std::max(0, (int)std::ceil(min_x * field.resolution - 0.5f));
+    int i1 = std::min(width - 1, (int)std::floor(max_x * field.resolution - 0.5f));
+    int j0 = std::max(0, (int)std::ceil(-max_z * field.resolution - 0.5f));
+    int j1 = std::min(depth - 1, (int)std::floor(-min_z * field.resolution - 0.5f));
+    float highest = std::numeric_limits<float>::lowest();
+    for (int j = j0; j <= j1; ++j) {
+        for (int i = i0; i <= i1; ++i) {
+            float h = field.heights[j * width + i];
+            if (h <= max_height) {
+                highest = std::max(highest, h);
+            }
+        }
+    }
+    return highest;
+}
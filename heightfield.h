@@ -0,0 +1,43 @@
+#pragma once
+
+#include "maths.h"
+
+#include <vector>
+
+// Height of the ground over the grid, sampled resolution x resolution times per cell so that thin
+// walls and hedges show up. Cell (row, col) covers x in [col, col + 1] and z in [-(row + 1), -row]
+// like in the grid.
+struct Heightfield {
+    int rows = 0;
+    int cols = 0;
+    int resolution = 1;
+    // Samples at the centers of the sub-cells, row-major with cols * resolution samples per row
+    std::vector<float> heights;
+};
+
+void resize(Heightfield &field, int rows, int cols, int resolution);
+
+// Rewrites the samples of one cell, height(u, v) gets the position inside the cell in [0, 1]^2
+// with u along x and v along -z.
+template <typename HeightFunction>
+void set_cell(Heightfield &field, int row, int col, HeightFunction height) {
+    int width = field.cols * field.resolution;
+    for (int j = 0; j < field.resolution; ++j) {
+        for (int i = 0; i < field.resolution; ++i) {
+            float u = (i + 0.5f) / field.resolution;
+            float v = (j + 0.5f) / field.resolution;
+            int sample = (row * field.resolution + j) * width + col * field.resolution + i;
+            field.heights[sample] = height(u, v);
+        }
+    }
+}
+
+// Bilinear interpolation of the four samples around the point, clamped at the border.
+float height_at(const Heightfield &field, float x, float z);
+float height_at(const Heightfield &field, Vec3 position);
+
+// Highest sample in the box [min_x, max_x] x [min_z, max_z] that is not above max_height, what can
+// be stood on from there. Samples are not interpolated, the slopes between a wall and the ground
+// are not ground. Lowest float when there is none.
+float highest_ground(const Heightfield &field, float min_x, float max_x, float min_z, float max_z,
+                     float max_height);
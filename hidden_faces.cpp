@@ -0,0 +1,114 @@
+#include "hidden_faces.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Vertices are placed on a 1/1024 grid at most, the normals only need to tell the directions apart
+constexpr float centroid_quantization = 1024.f;
+constexpr float normal_quantization = 64.f;
+
+bool operator==(const FaceKey &a, const FaceKey &b) {
+    return a.cx == b.cx && a.cy == b.cy && a.cz == b.cz && a.nx == b.nx && a.ny == b.ny &&
+           a.nz == b.nz;
+}
+
+size_t FaceKeyHash::operator()(const FaceKey &key) const {
+    size_t h = 0;
+    for (int v : {key.cx, key.cy, key.cz, key.nx, key.ny, key.nz}) {
+        h = h * 0x9e3779b1u + std::hash<int>{}(v);
+    }
+    return h;
+}
+
+FaceKey face_key(Vec3 a, Vec3 b, Vec3 c) {
+    Vec3 center = centroid(a, b, c);
+    Vec3 n = normal_for_face(a, b, c);
+    return {(int)std::lround(center.x * centroid_quantization),
+            (int)std::lround(center.y * centroid_quantization),
+            (int)std::lround(center.z * centroid_quantization),
+            (int)std::lround(n.x * normal_quantization),
+            (int)std::lround(n.y * normal_quantization),
+            (int)std::lround(n.z * normal_quantization)};
+}
+
+FaceKey opposite(const FaceKey &key) {
+    return {key.cx, key.cy, key.cz, -key.nx, -key.ny, -key.nz};
+}
+
+void mark_opposite_owners_dirty(HiddenFaces &hidden, const FaceKey &key) {
+    auto it = hidden.faces.find(opposite(key));
+    if (it != hidden.faces.end()) {
+        for (const FaceRef &ref : it->second) {
+            hidden.dirty.insert(ref.owner);
+        }
+    }
+}
+
+void add_mesh(HiddenFaces &hidden, int owner, const Mesh &mesh, const Mat4 &transform) {
+    remove_mesh(hidden, owner);
+
+    std::vector<FaceKey> &keys = hidden.owners[owner];
+    int n_faces = mesh.vertices.size() / 3;
+    keys.reserve(n_faces);
+    for (int face_index = 0; face_index < n_faces; ++face_index) {
+        FaceKey key = face_key(transform * mesh.vertices[face_index * 3],
+                               transform * mesh.vertices[face_index * 3 + 1],
+                               transform * mesh.vertices[face_index * 3 + 2]);
+        keys.push_back(key);
+        hidden.faces[key].push_back({owner, face_index});
+        mark_opposite_owners_dirty(hidden, key);
+    }
+    hidden.dirty.insert(owner);
+}
+
+void remove_mesh(HiddenFaces &hidden, int owner) {
+    auto owner_it = hidden.owners.find(owner);
+    if (owner_it == hidden.owners.end()) {
+        return;
+    }
+
+    for (const FaceKey &key : owner_it->second) {
+        auto it = hidden.faces.find(key);
+        std::vector<FaceRef> &refs = it->second;
+        refs.erase(std::remove_if(refs.begin(), refs.end(),
+                                  [owner](const FaceRef &ref) { return ref.owner == owner; }),
+                   refs.end());
+        if (refs.empty()) {
+            hidden.faces.erase(it);
+        }
+        mark_opposite_owners_dirty(hidden, key);
+    }
+    hidden.owners.erase(owner_it);
+    hidden.dirty.erase(owner);
+}
+
+bool is_hidden(const HiddenFaces &hidden, int owner, int face_index) {
+    auto owner_it = hidden.owners.find(owner);
+    if (owner_it == hidden.owners.end()) {
+        return false;
+    }
+    return hidden.faces.count(opposite(owner_it->second[face_index])) > 0;
+}
+
+Mesh visible_mesh(const HiddenFaces &hidden, int owner, const Mesh &mesh) {
+    Mesh visible;
+    visible.vertices.reserve(mesh.vertices.size());
+    visible.normals.reserve(mesh.normals.size());
+    int n_faces = mesh.vertices.size() / 3;
+    for (int face_index = 0; face_index < n_faces; ++face_index) {
+        if (is_hidden(hidden, owner, face_index)) {
+            continue;
+        }
+        for (int i = face_index * 3; i < face_index * 3 + 3; ++i) {
+            visible.vertices.push_back(mesh.vertices[i]);
+            visible.normals.push_back(mesh.normals[i]);
+        }
+    }
+    return visible;
+}
+
+std::vector<int> take_dirty(HiddenFaces &hidden) {
+    std::vector<int> dirty(hidden.dirty.begin(), hidden.dirty.end());
+    hidden.dirty.clear();
+    return dirty;
+}
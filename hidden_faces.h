@@ -0,0 +1,53 @@
+#pragma once
+
+#include "maths.h"
+#include "memory.h"
+#include "mesh2.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Finds faces that are hidden because another mesh has the same triangle facing the other way,
+// for example the shared side of two walls next to each other. Faces are keyed by their quantized
+// centroid and normal in world space, so a face is hidden exactly when the key with the opposite
+// normal is present. Meshes can be added and removed one at a time, the owners whose visible faces
+// changed are collected so that only those need to be uploaded again.
+
+struct FaceKey {
+    int cx, cy, cz;
+    int nx, ny, nz;
+};
+
+bool operator==(const FaceKey &a, const FaceKey &b);
+
+struct FaceKeyHash {
+    size_t operator()(const FaceKey &key) const;
+};
+
+struct FaceRef {
+    int owner;
+    int face_index;
+};
+
+struct HiddenFaces {
+    std::unordered_map<FaceKey, std::vector<FaceRef>, FaceKeyHash, std::equal_to<FaceKey>,
+                       PoolAllocator<std::pair<const FaceKey, std::vector<FaceRef>>>>
+        faces;
+    std::unordered_map<int, std::vector<FaceKey>> owners;
+    std::unordered_set<int> dirty;
+};
+
+FaceKey face_key(Vec3 a, Vec3 b, Vec3 c);
+FaceKey opposite(const FaceKey &key);
+
+void add_mesh(HiddenFaces &hidden, int owner, const Mesh &mesh, const Mat4 &transform);
+void remove_mesh(HiddenFaces &hidden, int owner);
+
+bool is_hidden(const HiddenFaces &hidden, int owner, int face_index);
+
+// Copy of the mesh of the owner without its hidden faces, in the mesh local space.
+Mesh visible_mesh(const HiddenFaces &hidden, int owner, const Mesh &mesh);
+
+// Owners whose hidden faces changed since the last call.
+std::vector<int> take_dirty(HiddenFaces &hidden);
@@ -0,0 +1,180 @@
+#include "lattice.h"
+
+#include <cassert>
+#include <cmath>
+
+bool operator==(const LatticeCell &a, const LatticeCell &b) {
+    return a.type == b.type && a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool operator!=(const LatticeCell &a, const LatticeCell &b) { return !(a == b); }
+
+size_t LatticeCellHash::operator()(const LatticeCell &cell) const {
+    // 21 bits per coordinate is plenty for any level we will build
+    uint64_t key = (uint64_t)(cell.x & 0x1fffff) | ((uint64_t)(cell.y & 0x1fffff) << 21) |
+                   ((uint64_t)(cell.z & 0x1fffff) << 42) | ((uint64_t)cell.type << 63);
+    return std::hash<uint64_t>{}(key);
+}
+
+int parity(int x, int y, int z) { return (x + y + z) & 1; }
+
+bool is_valid(const LatticeCell &cell) {
+    return cell.type == LatticeCell::Type::Tetrahedron || parity(cell.x, cell.y, cell.z) == 1;
+}
+
+int n_faces(const LatticeCell &cell) { return cell.type == LatticeCell::Type::Tetrahedron ? 4 : 8; }
+
+// Each face of a tetrahedron looks at one of the odd corners of its cube. The parity of the cube
+// fixes the z offset of these corners, so the x and y offsets are enough to index them.
+LatticePoint tetra_face_corner(const LatticeCell &cell, int face_index) {
+    int ox = face_index & 1;
+    int oy = (face_index >> 1) & 1;
+    int oz = (1 + parity(cell.x, cell.y, cell.z) + ox + oy) & 1;
+    return {ox, oy, oz};
+}
+
+// Each face of an octahedron lies in one octant around its center, bit set means positive side.
+LatticePoint octa_face_signs(int face_index) {
+    return {(face_index & 1) ? 1 : -1, (face_index & 2) ? 1 : -1, (face_index & 4) ? 1 : -1};
+}
+
+LatticeCell neighbor(const LatticeCell &cell, int face_index) {
+    assert(face_index >= 0 && face_index < n_faces(cell));
+    if (cell.type == LatticeCell::Type::Tetrahedron) {
+        LatticePoint o = tetra_face_corner(cell, face_index);
+        return {LatticeCell::Type::Octahedron, cell.x + o.x, cell.y + o.y, cell.z + o.z};
+    } else {
+        LatticePoint s = octa_face_signs(face_index);
+        return {LatticeCell::Type::Tetrahedron, cell.x + (s.x > 0 ? 0 : -1),
+                cell.y + (s.y > 0 ? 0 : -1), cell.z + (s.z > 0 ? 0 : -1)};
+    }
+}
+
+int opposite_face(const LatticeCell &cell, int face_index) {
+    if (cell.type == LatticeCell::Type::Tetrahedron) {
+        LatticePoint o = tetra_face_corner(cell, face_index);
+        return (1 - o.x) | ((1 - o.y) << 1) | ((1 - o.z) << 2);
+    } else {
+        LatticePoint s = octa_face_signs(face_index);
+        return (s.x > 0 ? 0 : 1) | ((s.y > 0 ? 0 : 1) << 1);
+    }
+}
+
+std::array<LatticePoint, 3> face_vertices(const LatticeCell &cell, int face_index) {
+    if (cell.type == LatticeCell::Type::Tetrahedron) {
+        // same triangle as the octahedron face, but seen from the other side
+        auto v = face_vertices(neighbor(cell, face_index), opposite_face(cell, face_index));
+        return {v[0], v[2], v[1]};
+    }
+
+    LatticePoint s = octa_face_signs(face_index);
+    LatticePoint a = {cell.x + s.x, cell.y, cell.z};
+    LatticePoint b = {cell.x, cell.y + s.y, cell.z};
+    LatticePoint c = {cell.x, cell.y, cell.z + s.z};
+    if (s.x * s.y * s.z < 0) {
+        return {a, c, b};
+    }
+    return {a, b, c};
+}
+
+std::array<LatticePoint, 6> octa_vertices(const LatticeCell &cell) {
+    return {LatticePoint{cell.x, cell.y + 1, cell.z}, {cell.x, cell.y - 1, cell.z},
+            {cell.x, cell.y, cell.z + 1},             {cell.x, cell.y, cell.z - 1},
+            {cell.x - 1, cell.y, cell.z},             {cell.x + 1, cell.y, cell.z}};
+}
+
+std::array<LatticePoint, 4> tetra_vertices(const LatticeCell &cell) {
+    std::array<LatticePoint, 4> vertices;
+    int n = 0;
+    for (int i = 0; i < 8; ++i) {
+        LatticePoint p = {cell.x + (i & 1), cell.y + ((i >> 1) & 1), cell.z + ((i >> 2) & 1)};
+        if (parity(p.x, p.y, p.z) == 0) {
+            vertices[n++] = p;
+        }
+    }
+    return vertices;
+}
+
+float lattice_scale() { return lattice_edge_length / std::sqrt(2.f); }
+
+Vec3 to_world(const LatticePoint &p) {
+    return Vec3{(float)p.x, (float)p.y, (float)p.z} * lattice_scale();
+}
+
+Vec3 cell_center(const LatticeCell &cell) {
+    Vec3 p = {(float)cell.x, (float)cell.y, (float)cell.z};
+    if (cell.type == LatticeCell::Type::Tetrahedron) {
+        p += Vec3{0.5f, 0.5f, 0.5f};
+    }
+    return p * lattice_scale();
+}
+
+LatticeCell cell_at(Vec3 world_point) {
+    Vec3 q = world_point / lattice_scale();
+    LatticeCell cube = {LatticeCell::Type::Tetrahedron, (int)std::floor(q.x), (int)std::floor(q.y),
+                        (int)std::floor(q.z)};
+    Vec3 f = q - Vec3{(float)cube.x, (float)cube.y, (float)cube.z};
+
+    // The corners of the cube around odd points belong to octahedra, the rest is the tetrahedron.
+    for (int face_index = 0; face_index < 4; ++face_index) {
+        LatticePoint o = tetra_face_corner(cube, face_index);
+        float distance = std::abs(f.x - o.x) + std::abs(f.y - o.y) + std::abs(f.z - o.z);
+        if (distance < 1.f) {
+            return {LatticeCell::Type::Octahedron, cube.x + o.x, cube.y + o.y, cube.z + o.z};
+        }
+    }
+    return cube;
+}
+
+void append_faces(std::vector<Vec3> &vertices, const LatticeCell &cell) {
+    for (int face_index = 0; face_index < n_faces(cell); ++face_index) {
+        for (const LatticePoint &p : face_vertices(cell, face_index)) {
+            vertices.push_back(to_world(p));
+        }
+    }
+}
+
+Mesh lattice_mesh(const LatticeCell &cell) {
+    Mesh mesh;
+    mesh.vertices.reserve(n_faces(cell) * 3);
+    append_faces(mesh.vertices, cell);
+    mesh.normals = compute_normals(mesh.vertices);
+    return mesh;
+}
+
+bool add(Honeycomb &honeycomb, const LatticeCell &cell) {
+    assert(is_valid(cell));
+    return honeycomb.cells.insert(cell).second;
+}
+
+bool remove(Honeycomb &honeycomb, const LatticeCell &cell) {
+    return honeycomb.cells.erase(cell) > 0;
+}
+
+bool contains(const Honeycomb &honeycomb, const LatticeCell &cell) {
+    return honeycomb.cells.count(cell) > 0;
+}
+
+LatticeCell add_on_face(Honeycomb &honeycomb, const LatticeFace &face) {
+    LatticeCell cell = neighbor(face.cell, face.face_index);
+    add(honeycomb, cell);
+    return cell;
+}
+
+Mesh honeycomb_mesh(const Honeycomb &honeycomb) {
+    Mesh mesh;
+    mesh.vertices.reserve(honeycomb.cells.size() * 8 * 3);
+    for (const LatticeCell &cell : honeycomb.cells) {
+        for (int face_index = 0; face_index < n_faces(cell); ++face_index) {
+            // a face shared with another piece is inside the structure and never visible
+            if (contains(honeycomb, neighbor(cell, face_index))) {
+                continue;
+            }
+            for (const LatticePoint &p : face_vertices(cell, face_index)) {
+                mesh.vertices.push_back(to_world(p));
+            }
+        }
+    }
+    mesh.normals = compute_normals(mesh.vertices);
+    return mesh;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "maths.h"
+#include "mesh2.h"
+
+#include <array>
+#include <cstdint>
+#include <unordered_set>
+
+// Tetrahedral-octahedral honeycomb addressed with integer coordinates.
+//
+// The vertices of the honeycomb are the integer points with an even coordinate sum. Every unit
+// cube holds exactly one tetrahedron (its four even corners) and every odd integer point is the
+// center of an octahedron (its six neighbors at distance 1). Pieces are stored by these integer
+// coordinates only, so placing thousands of them never accumulates floating point error and every
+// adjacency query is a few integer operations.
+
+struct LatticePoint {
+    int x{0};
+    int y{0};
+    int z{0};
+};
+
+struct LatticeCell {
+    enum Type { Tetrahedron, Octahedron };
+    Type type = Type::Tetrahedron;
+    // Tetrahedron: minimum corner of its unit cube. Octahedron: its center (odd coordinate sum).
+    int x{0};
+    int y{0};
+    int z{0};
+};
+
+struct LatticeFace {
+    LatticeCell cell;
+    int face_index;
+};
+
+bool operator==(const LatticeCell &a, const LatticeCell &b);
+bool operator!=(const LatticeCell &a, const LatticeCell &b);
+
+struct LatticeCellHash {
+    size_t operator()(const LatticeCell &cell) const;
+};
+
+// Length of an edge in world units. Lattice edges have length sqrt(2), we scale them to 1.
+constexpr float lattice_edge_length = 1.f;
+
+bool is_valid(const LatticeCell &cell);
+int n_faces(const LatticeCell &cell);
+
+// Cell sharing the given face. Across a tetrahedron face there is always an octahedron and
+// the other way around, so the type of the neighbor is fixed by the honeycomb.
+LatticeCell neighbor(const LatticeCell &cell, int face_index);
+
+// Index of the shared face as seen from the neighbor: neighbor(neighbor(c, f), opposite_face(c, f))
+// is c again.
+int opposite_face(const LatticeCell &cell, int face_index);
+
+// Face vertices, counter-clockwise when seen from outside the cell.
+std::array<LatticePoint, 3> face_vertices(const LatticeCell &cell, int face_index);
+std::array<LatticePoint, 6> octa_vertices(const LatticeCell &cell);
+std::array<LatticePoint, 4> tetra_vertices(const LatticeCell &cell);
+
+Vec3 to_world(const LatticePoint &p);
+Vec3 cell_center(const LatticeCell &cell);
+LatticeCell cell_at(Vec3 world_point);
+
+Mesh lattice_mesh(const LatticeCell &cell);
+
+struct Honeycomb {
+    std::unordered_set<LatticeCell, LatticeCellHash> cells;
+};
+
+bool add(Honeycomb &honeycomb, const LatticeCell &cell);
+bool remove(Honeycomb &honeycomb, const LatticeCell &cell);
+bool contains(const Honeycomb &honeycomb, const LatticeCell &cell);
+
+// Adds the cell on the other side of the face and returns it.
+LatticeCell add_on_face(Honeycomb &honeycomb, const LatticeFace &face);
+
+// Outer surface of the honeycomb, faces between two pieces are left out.
+Mesh honeycomb_mesh(const Honeycomb &honeycomb);
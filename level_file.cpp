@@ -0,0 +1,143 @@
+#include "level_file.h"
+
+#include "memory.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+LevelFile load_level_file(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open level " + path);
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    size_t width = 0;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            width = std::max(width, line.size());
+            lines.push_back(line);
+        }
+    }
+    if (lines.empty()) {
+        throw std::runtime_error("Level " + path + " is empty");
+    }
+
+    LevelFile level;
+    level.rows = lines.size();
+    level.cols = (width + 1) / 2;
+    level.definition.reserve(level.rows * level.cols * 2);
+    for (std::string &row : lines) {
+        row.resize(level.cols * 2, ' ');
+        level.definition += row;
+    }
+    return level;
+}
+
+LevelReload prepare_reload(const Grid &grid, const std::string &path) {
+    MemoryScope scope(MemoryTag::Grid);
+    LevelReload reload;
+    reload.level = load_level_file(path);
+    int rows = reload.level.rows;
+    int cols = reload.level.cols;
+    std::vector<CellDefinition> cells = parse_definition(reload.level.definition, rows, cols);
+    if (rows != grid.rows || cols != grid.cols) {
+        reload.resized = true;
+        return reload;
+    }
+
+    for (int index = 0; index < rows * cols; ++index) {
+        const Cell &cell = grid.cells[index];
+        if (cells[index].type != cell.type || cells[index].prop.axis != cell.prop.axis) {
+            reload.changed.push_back(index);
+        }
+        if (cells[index].type == Cell::Type::Start) {
+            reload.start = index;
+        } else if (cells[index].type == Cell::Type::End) {
+            reload.end = index;
+        }
+    }
+
+    reload.cells.resize(reload.changed.size());
+    parallel_for(0, reload.changed.size(), [&](int k) {
+        int index = reload.changed[k];
+        reload.cells[k] = make_cell(grid, index / cols, index % cols, cells[index].type,
+                                    cells[index].prop);
+    }, 16);
+    return reload;
+}
+
+// The grid as it will be once the reload is applied, only with what the graph and the bake read:
+// the types of the cells, and their triangles for the bake
+Grid reloaded_grid(const Grid &grid, const LevelReload &reload, bool with_triangles) {
+    Grid next;
+    next.rows = grid.rows;
+    next.cols = grid.cols;
+    next.start = reload.start;
+    next.end = reload.end;
+    next.cells.resize(grid.cells.size());
+    auto copy = [&](Cell &to, const Cell &from) {
+        to.type = from.type;
+        to.prop = from.prop;
+        if (with_triangles) {
+            to.entity.mesh.vertices = from.entity.mesh.vertices;
+            to.entity.transform = from.entity.transform;
+        }
+    };
+    parallel_for(0, grid.cells.size(),
+                 [&](int index) { copy(next.cells[index], grid.cells[index]); }, 4096);
+    for (int k = 0; k < reload.changed.size(); ++k) {
+        copy(next.cells[reload.changed[k]], reload.cells[k]);
+    }
+    if (with_triangles) {
+        build_cell_triangles(next);
+    }
+    return next;
+}
+
+void relink_and_rebake(LevelReload &reload, const Grid &grid, const GridGraph *graph,
+                       const BakedLighting *baked) {
+    if (reload.resized || reload.changed.empty() || (!graph && !baked)) {
+        return;
+    }
+    MemoryScope scope(MemoryTag::Grid);
+    Grid next = reloaded_grid(grid, reload, baked != nullptr);
+    if (graph) {
+        reload.graph = *graph;
+        update_grid_graph(*reload.graph, next, reload.changed);
+    }
+    if (baked) {
+        reload.baked = *baked;
+        reload.baked->texture = 0;
+        rebake_cells(*reload.baked, next, reload.changed);
+    }
+}
+
+void apply_reload(Grid &grid, LevelReload &reload) {
+    MemoryScope scope(MemoryTag::Grid);
+    if (reload.resized) {
+        // What was derived from the previous grid must see a new version
+        int version = grid.version;
+        free_grid(grid);
+        grid = make_grid_from_definition(reload.level.definition, reload.level.rows,
+                                         reload.level.cols);
+        grid.version = std::max(grid.version, version + 1);
+        return;
+    }
+
+    for (int k = 0; k < reload.changed.size(); ++k) {
+        int index = reload.changed[k];
+        grid.cells[index] = std::move(reload.cells[k]);
+        update_heightfield(grid, index / grid.cols, index % grid.cols);
+    }
+    grid.start = reload.start;
+    grid.end = reload.end;
+    if (!reload.changed.empty()) {
+        update_grid(grid);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "bake.h"
+#include "grid.h"
+#include "grid_graph.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// Levels are text files of the definition given to make_grid_from_definition, one line per row and
+// two characters per cell. Lines shorter than the longest one end with floor, for editors that
+// strip trailing spaces.
+
+struct LevelFile {
+    int rows = 0;
+    int cols = 0;
+    std::string definition;
+};
+
+// Throws when the file cannot be read or is empty.
+LevelFile load_level_file(const std::string &path);
+
+// New version of a level, as the cells that differ from the current grid.
+struct LevelReload {
+    LevelFile level;
+    bool resized = false; // the grid is made again from the whole definition
+    std::vector<int> changed;
+    std::vector<Cell> cells; // in the order of changed
+    int start = -1;
+    int end = -1;
+    // Linked and baked again for the new cells, when asked
+    std::optional<GridGraph> graph;
+    std::optional<BakedLighting> baked; // without a texture
+};
+
+// Loads and parses the file and makes the meshes of the changed cells, without GL so that it runs
+// on a background thread while the grid is only read. Throws on a bad file, the grid is then left
+// as it is.
+LevelReload prepare_reload(const Grid &grid, const std::string &path);
+
+// Updates copies of the graph and of the bake around the changed cells, each only when given, on a
+// copy of the grid with the new cells. Does not call GL and only reads the grid, the graph and the
+// bake, so that it runs on the same thread as prepare_reload. Nothing is done when resized or when
+// no cell changed.
+void relink_and_rebake(LevelReload &reload, const Grid &grid, const GridGraph *graph,
+                       const BakedLighting *baked);
+
+// Puts the new cells in the grid and updates its blocks, on the GL thread.
+void apply_reload(Grid &grid, LevelReload &reload);
@@ -0,0 +1,358 @@
+#include "level_generator.h"
+
+#include "logging.h"
+#include "memory.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+// Cells while generating, the axis of walls and hedges is only chosen when writing the definition
+enum class Tile : uint8_t { Floor, Wall, Hedge, Platform, RaisedPlatform };
+
+// splitmix64, the same sequence on every platform unlike the standard distributions
+struct Random {
+    uint64_t state;
+};
+
+uint64_t next_random(Random &random) {
+    uint64_t z = (random.state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// In [0, n)
+int random_below(Random &random, int n) {
+    assert(n > 0);
+    return next_random(random) % n;
+}
+
+Random region_random(uint64_t seed, uint64_t region) {
+    Random random{seed};
+    random.state = next_random(random) ^ (region * 0xd1b54a32d192ed03);
+    return random;
+}
+
+LevelKind parse_level_kind(const std::string &name) {
+    if (name == "maze") {
+        return LevelKind::Maze;
+    } else if (name == "rooms") {
+        return LevelKind::Rooms;
+    } else if (name == "platforms") {
+        return LevelKind::Platforms;
+    }
+    throw std::runtime_error("Unknown level kind: '" + name + "'");
+}
+
+struct TileGrid {
+    int rows;
+    int cols;
+    std::vector<Tile> tiles;
+};
+
+Tile &tile_at(TileGrid &grid, int row, int col) {
+    return grid.tiles[(long)row * grid.cols + col];
+}
+
+// Random spanning tree of a width x height grid of nodes by depth first search. Bit 0 of a node
+// links it to the node on its right, bit 1 to the node below.
+std::vector<uint8_t> spanning_tree(int width, int height, Random &random) {
+    std::vector<uint8_t> links(width * height, 0);
+    std::vector<bool> visited(width * height, false);
+    std::vector<int> stack = {0};
+    visited[0] = true;
+    while (!stack.empty()) {
+        int node = stack.back();
+        int x = node % width;
+        int y = node / width;
+        int neighbors[4];
+        int n = 0;
+        if (x + 1 < width && !visited[node + 1]) {
+            neighbors[n++] = node + 1;
+        }
+        if (x > 0 && !visited[node - 1]) {
+            neighbors[n++] = node - 1;
+        }
+        if (y + 1 < height && !visited[node + width]) {
+            neighbors[n++] = node + width;
+        }
+        if (y > 0 && !visited[node - width]) {
+            neighbors[n++] = node - width;
+        }
+        if (n == 0) {
+            stack.pop_back();
+            continue;
+        }
+
+        int next = neighbors[random_below(random, n)];
+        if (next == node + 1) {
+            links[node] |= 1;
+        } else if (next == node - 1) {
+            links[next] |= 1;
+        } else if (next == node + width) {
+            links[node] |= 2;
+        } else {
+            links[next] |= 2;
+        }
+        visited[next] = true;
+        stack.push_back(next);
+    }
+    return links;
+}
+
+// Nodes are the cells at odd rows and columns, the cells between two nodes are opened to link
+// them. Each region is a spanning tree of its nodes, and the regions are linked by another
+// spanning tree with one opening between linked regions.
+void generate_maze(TileGrid &grid, const LevelParameters &param) {
+    std::fill(grid.tiles.begin(), grid.tiles.end(), Tile::Wall);
+    int node_rows = (grid.rows - 1) / 2;
+    int node_cols = (grid.cols - 1) / 2;
+    int size = std::max(1, param.region_size / 2);
+    int region_rows = (node_rows + size - 1) / size;
+    int region_cols = (node_cols + size - 1) / size;
+
+    parallel_for(0, region_rows * region_cols, [&](int region) {
+        int i0 = region / region_cols * size;
+        int j0 = region % region_cols * size;
+        int height = std::min(size, node_rows - i0);
+        int width = std::min(size, node_cols - j0);
+        Random random = region_random(param.seed, region);
+        std::vector<uint8_t> links = spanning_tree(width, height, random);
+        for (int i = 0; i < height; ++i) {
+            for (int j = 0; j < width; ++j) {
+                int row = 2 * (i0 + i) + 1;
+                int col = 2 * (j0 + j) + 1;
+                tile_at(grid, row, col) = Tile::Floor;
+                if (links[i * width + j] & 1) {
+                    tile_at(grid, row, col + 1) = Tile::Floor;
+                }
+                if (links[i * width + j] & 2) {
+                    tile_at(grid, row + 1, col) = Tile::Floor;
+                }
+            }
+        }
+    }, 1);
+
+    Random random = region_random(param.seed, region_rows * region_cols);
+    std::vector<uint8_t> links = spanning_tree(region_cols, region_rows, random);
+    for (int a = 0; a < region_rows; ++a) {
+        for (int b = 0; b < region_cols; ++b) {
+            int height = std::min(size, node_rows - a * size);
+            int width = std::min(size, node_cols - b * size);
+            if (links[a * region_cols + b] & 1) {
+                int i = a * size + random_below(random, height);
+                tile_at(grid, 2 * i + 1, 2 * (b + 1) * size) = Tile::Floor;
+            }
+            if (links[a * region_cols + b] & 2) {
+                int j = b * size + random_below(random, width);
+                tile_at(grid, 2 * (a + 1) * size, 2 * j + 1) = Tile::Floor;
+            }
+        }
+    }
+}
+
+struct Room {
+    int top;
+    int left;
+    int bottom; // row of the wall below
+    int right;  // column of the wall on the right
+};
+
+// Recursive division of the room with hedges. Hedges are on even rows and columns and their doors
+// on odd ones, so that a hedge never closes the door of another.
+void divide_room(TileGrid &grid, Room first, Random &random) {
+    constexpr int min_room = 3;
+    std::vector<Room> rooms = {first};
+    while (!rooms.empty()) {
+        Room room = rooms.back();
+        rooms.pop_back();
+        int height = room.bottom - room.top;
+        int width = room.right - room.left;
+        // The last region can be cut down to nothing by the border
+        if (height < 1 || width < 1) {
+            continue;
+        }
+        // Even rows or columns at least min_room away from both sides
+        int first_row = (room.top + min_room + 1) / 2 * 2;
+        int last_row = room.bottom - min_room - 1;
+        int rows = last_row >= first_row ? (last_row - first_row) / 2 + 1 : 0;
+        int first_col = (room.left + min_room + 1) / 2 * 2;
+        int last_col = room.right - min_room - 1;
+        int cols = last_col >= first_col ? (last_col - first_col) / 2 + 1 : 0;
+        bool small = height <= 10 && width <= 10;
+        if ((rows == 0 && cols == 0) || (small && random_below(random, 2) == 0)) {
+            if (height >= min_room && width >= min_room && random_below(random, 3) == 0) {
+                tile_at(grid, (room.top + room.bottom) / 2, (room.left + room.right) / 2) =
+                    Tile::Platform;
+            }
+            continue;
+        }
+
+        bool horizontal = cols == 0 || (rows > 0 && (height > width ||
+                                                     (height == width && random_below(random, 2))));
+        if (horizontal) {
+            int row = first_row + 2 * random_below(random, rows);
+            for (int col = room.left; col < room.right; ++col) {
+                tile_at(grid, row, col) = Tile::Hedge;
+            }
+            tile_at(grid, row, room.left + 2 * random_below(random, (width + 1) / 2)) = Tile::Floor;
+            rooms.push_back({room.top, room.left, row, room.right});
+            rooms.push_back({row + 1, room.left, room.bottom, room.right});
+        } else {
+            int col = first_col + 2 * random_below(random, cols);
+            for (int row = room.top; row < room.bottom; ++row) {
+                tile_at(grid, row, col) = Tile::Hedge;
+            }
+            tile_at(grid, room.top + 2 * random_below(random, (height + 1) / 2), col) = Tile::Floor;
+            rooms.push_back({room.top, room.left, room.bottom, col});
+            rooms.push_back({room.top, col + 1, room.bottom, room.right});
+        }
+    }
+}
+
+// Regions are walled on their top and left sides with one door each, which links every region
+// to the ones above and on the left.
+void generate_rooms(TileGrid &grid, const LevelParameters &param) {
+    std::fill(grid.tiles.begin(), grid.tiles.end(), Tile::Floor);
+    int size = std::max(8, param.region_size / 2 * 2);
+    int region_rows = (grid.rows - 2) / size + 1;
+    int region_cols = (grid.cols - 2) / size + 1;
+
+    parallel_for(0, region_rows * region_cols, [&](int region) {
+        int r0 = region / region_cols * size;
+        int c0 = region % region_cols * size;
+        int r1 = std::min(r0 + size, grid.rows - 1);
+        int c1 = std::min(c0 + size, grid.cols - 1);
+        Random random = region_random(param.seed, region);
+        for (int col = c0; col < c1; ++col) {
+            tile_at(grid, r0, col) = Tile::Wall;
+        }
+        for (int row = r0; row < r1; ++row) {
+            tile_at(grid, row, c0) = Tile::Wall;
+        }
+        if (r0 > 0 && c1 - c0 >= 2) {
+            tile_at(grid, r0, c0 + 1 + 2 * random_below(random, (c1 - c0) / 2)) = Tile::Floor;
+        }
+        if (c0 > 0 && r1 - r0 >= 2) {
+            tile_at(grid, r0 + 1 + 2 * random_below(random, (r1 - r0) / 2), c0) = Tile::Floor;
+        }
+        divide_room(grid, {r0 + 1, c0 + 1, r1, c1}, random);
+    }, 1);
+}
+
+float lattice_value(uint64_t seed, int x, int y) {
+    Random random{seed ^ ((uint64_t)(uint32_t)x << 32 | (uint32_t)y)};
+    return (next_random(random) >> 40) / float(1 << 24);
+}
+
+// Value noise, interpolated between random values on a lattice of the given spacing
+float value_noise(uint64_t seed, int row, int col, int spacing) {
+    int x = col / spacing;
+    int y = row / spacing;
+    auto smooth = [](float t) { return t * t * (3 - 2 * t); };
+    float u = smooth((col % spacing) / (float)spacing);
+    float v = smooth((row % spacing) / (float)spacing);
+    float top = lattice_value(seed, x, y) * (1 - u) + lattice_value(seed, x + 1, y) * u;
+    float bottom = lattice_value(seed, x, y + 1) * (1 - u) + lattice_value(seed, x + 1, y + 1) * u;
+    return top * (1 - v) + bottom * v;
+}
+
+void generate_platforms(TileGrid &grid, const LevelParameters &param) {
+    int size = std::max(1, param.region_size);
+    int region_rows = (grid.rows + size - 1) / size;
+    int region_cols = (grid.cols + size - 1) / size;
+    uint64_t seed = region_random(param.seed, 0).state;
+
+    // The noise only depends on the cell, regions do not show
+    parallel_for(0, region_rows * region_cols, [&](int region) {
+        int r0 = region / region_cols * size;
+        int c0 = region % region_cols * size;
+        for (int row = r0; row < std::min(r0 + size, grid.rows); ++row) {
+            for (int col = c0; col < std::min(c0 + size, grid.cols); ++col) {
+                float noise = value_noise(seed, row, col, 8);
+                tile_at(grid, row, col) = noise > 0.7f    ? Tile::RaisedPlatform
+                                          : noise > 0.55f ? Tile::Platform
+                                                          : Tile::Floor;
+            }
+        }
+    }, 1);
+}
+
+// Walls and hedges are along x when they continue on the left or the right
+const char *cell_definition(TileGrid &grid, int row, int col) {
+    Tile tile = tile_at(grid, row, col);
+    bool along_x = (col > 0 && tile_at(grid, row, col - 1) == tile) ||
+                   (col + 1 < grid.cols && tile_at(grid, row, col + 1) == tile);
+    switch (tile) {
+    case Tile::Floor:
+        return "  ";
+    case Tile::Wall:
+        return along_x ? "==" : "||";
+    case Tile::Hedge:
+        return along_x ? "--" : "| ";
+    case Tile::Platform:
+        return "__";
+    case Tile::RaisedPlatform:
+        return "TT";
+    }
+    return "  ";
+}
+
+std::string generate_definition(const LevelParameters &param) {
+    // Smaller levels end on the start
+    if (param.rows < 5 || param.cols < 5) {
+        throw std::runtime_error("Levels need at least 5 rows and columns, got " +
+                                 std::to_string(param.rows) + "x" + std::to_string(param.cols));
+    }
+    MemoryScope scope(MemoryTag::Grid);
+    Timer timer;
+    TileGrid grid{param.rows, param.cols, std::vector<Tile>((long)param.rows * param.cols)};
+
+    int end_row = grid.rows - 2;
+    int end_col = grid.cols - 2;
+    switch (param.kind) {
+    case LevelKind::Maze:
+        generate_maze(grid, param);
+        // Last node
+        end_row = (grid.rows - 1) / 2 * 2 - 1;
+        end_col = (grid.cols - 1) / 2 * 2 - 1;
+        break;
+    case LevelKind::Rooms:
+        generate_rooms(grid, param);
+        break;
+    case LevelKind::Platforms:
+        generate_platforms(grid, param);
+        break;
+    }
+
+    for (int row = 0; row < grid.rows; ++row) {
+        tile_at(grid, row, 0) = Tile::Wall;
+        tile_at(grid, row, grid.cols - 1) = Tile::Wall;
+    }
+    for (int col = 0; col < grid.cols; ++col) {
+        tile_at(grid, 0, col) = Tile::Wall;
+        tile_at(grid, grid.rows - 1, col) = Tile::Wall;
+    }
+    tile_at(grid, 1, 1) = Tile::Floor;
+    tile_at(grid, end_row, end_col) = Tile::Floor;
+
+    std::string def(grid.tiles.size() * 2, ' ');
+    parallel_for(0, grid.rows, [&](int row) {
+        for (int col = 0; col < grid.cols; ++col) {
+            const char *cell = cell_definition(grid, row, col);
+            long index = ((long)row * grid.cols + col) * 2;
+            def[index] = cell[0];
+            def[index + 1] = cell[1];
+        }
+    }, 16);
+    def[(grid.cols + 1) * 2] = 'a';
+    def[((long)end_row * grid.cols + end_col) * 2] = 'z';
+
+    log("generated " + std::to_string(grid.rows) + "x" + std::to_string(grid.cols) + " level in " +
+        std::to_string(timer.seconds_elapsed()) + " s");
+    return def;
+}
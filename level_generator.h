@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Seeded levels of any size, written in the cell vocabulary of make_grid_from_definition. The grid
+// is cut in square regions generated in parallel, each from its own seed, so that the same
+// parameters give the same level whatever the number of threads.
+
+enum class LevelKind {
+    Maze,     // perfect maze of walls, one path between any two cells
+    Rooms,    // rooms walled by hedges inside regions walled by walls
+    Platforms // open floor with fields of platforms and raised platforms
+};
+
+struct LevelParameters {
+    LevelKind kind = LevelKind::Maze;
+    int rows = 64;
+    int cols = 64;
+    uint64_t seed = 1;
+    int region_size = 128; // in cells
+};
+
+// Throws on an unknown name.
+LevelKind parse_level_kind(const std::string &name);
+
+// Two characters per cell, rows * cols cells, at least 5 x 5. Bordered by walls, starts near the
+// first cell and ends near the last one.
+std::string generate_definition(const LevelParameters &param);
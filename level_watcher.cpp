@@ -0,0 +1,66 @@
+#include "level_watcher.h"
+
+#include "logging.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+LevelWatcher make_level_watcher(const std::string &path) {
+    LevelWatcher watcher;
+#ifdef __linux__
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "."
+                            : slash == 0               ? "/"
+                                                       : path.substr(0, slash);
+    watcher.file = slash == std::string::npos ? path : path.substr(slash + 1);
+    watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher.fd >= 0 &&
+        inotify_add_watch(watcher.fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(watcher.fd);
+        watcher.fd = -1;
+    }
+    if (watcher.fd < 0) {
+        log("cannot watch " + path + ", it will not be reloaded");
+    }
+#else
+    log("levels are only reloaded on Linux");
+#endif
+    return watcher;
+}
+
+void free_level_watcher(LevelWatcher &watcher) {
+#ifdef __linux__
+    if (watcher.fd >= 0) {
+        close(watcher.fd);
+    }
+#endif
+    watcher.fd = -1;
+}
+
+bool level_changed(LevelWatcher &watcher) {
+#ifdef __linux__
+    if (watcher.fd < 0) {
+        return false;
+    }
+    bool changed = false;
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t n = read(watcher.fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        for (char *p = buffer; p < buffer + n;) {
+            const inotify_event *event = (const inotify_event *)p;
+            if (event->len && watcher.file == event->name) {
+                changed = true;
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+// Tells when a level file was written, with inotify on Linux and never elsewhere. The directory is
+// watched rather than the file, editors often save by writing another file and renaming it.
+
+struct LevelWatcher {
+    int fd = -1;
+    std::string file; // name in the directory
+};
+
+LevelWatcher make_level_watcher(const std::string &path);
+void free_level_watcher(LevelWatcher &watcher);
+
+// True when the file was written since the last call, never blocks.
+bool level_changed(LevelWatcher &watcher);
@@ -0,0 +1,309 @@
+#include "lights.h"
+
+#include "memory.h"
+#include "raycast.h"
+#include "render_stats.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LIGHTS_X86
+#endif
+
+// std430 layouts of phong_fragment.glsl
+struct GpuLight {
+    float position_radius[4];
+    float color[4];
+};
+
+struct GpuClustersHeader {
+    float params[4]; // near, slice scale, tiles per pixel in x and y
+};
+
+struct GpuClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+LightClusters make_light_clusters() {
+    MemoryScope scope(MemoryTag::Render);
+    LightClusters clusters;
+    // The variants with clustered lights are compiled as #version 430
+    clusters.supported = GLEW_VERSION_4_3;
+    clusters.offsets.resize(cluster_slices);
+    clusters.indices.resize(cluster_slices);
+    for (auto &offsets : clusters.offsets) {
+        offsets.resize(cluster_tiles + 1);
+    }
+    return clusters;
+}
+
+std::vector<PointLight> make_torches(const Grid &grid) {
+    std::vector<PointLight> lights;
+    for (int row = 0; row < grid.rows; ++row) {
+        for (int col = 0; col < grid.cols; ++col) {
+            int index = index_at(grid, row, col);
+            Cell::Type type = grid.cells[index].type;
+            // Every few wall cells, spread so that neighbors do not all get one
+            if (type == Cell::Type::Wall && (row * 7 + col * 3) % 5 == 0) {
+                Vec3 position = coord_at(grid, index) + Vec3{0.f, 1.5f, 0.f};
+                lights.push_back({position, {1.f, 0.6f, 0.3f}, 4.f});
+            }
+        }
+    }
+    if (grid.end >= 0 && grid.end < grid.cells.size()) {
+        lights.push_back({coord_at(grid, grid.end) + Vec3{0.f, 1.f, 0.f}, {0.3f, 1.f, 0.4f}, 3.f});
+    }
+    return lights;
+}
+
+// Near and far planes from a matrix made by perspective()
+void near_far(const Mat4 &projection, float &near, float &far) {
+    float a = projection.val(2, 2);
+    float b = projection.val(2, 3);
+    near = b / (a - 1);
+    far = b / (a + 1);
+}
+
+int slice_of(const LightClusters &clusters, float depth) {
+    depth = std::min(std::max(depth, clusters.near), clusters.far);
+    int slice = std::log(depth / clusters.near) * clusters.slice_scale;
+    return std::min(std::max(slice, 0), cluster_slices - 1);
+}
+
+int tile_of(float ndc, int tiles) {
+    int tile = std::floor((ndc + 1) * 0.5f * tiles);
+    return std::min(std::max(tile, 0), tiles - 1);
+}
+
+// From the depth range and the screen rectangle of the sphere in normalized device coordinates
+LightBounds to_bounds(const LightClusters &clusters, float depth_min, float depth_max,
+                      float left, float right, float bottom, float top) {
+    if (depth_max < clusters.near || depth_min > clusters.far || right < -1 || left > 1 ||
+        top < -1 || bottom > 1) {
+        return {.slice_min = 1, .slice_max = 0};
+    }
+    return {.slice_min = slice_of(clusters, depth_min),
+            .slice_max = slice_of(clusters, depth_max),
+            .x_min = tile_of(left, cluster_tiles_x),
+            .x_max = tile_of(right, cluster_tiles_x),
+            .y_min = tile_of(bottom, cluster_tiles_y),
+            .y_max = tile_of(top, cluster_tiles_y)};
+}
+
+// The screen rectangle is the one of the bounding box of the sphere in view space. x / depth is
+// monotonic in depth so its extremes are at the ends of the depth range.
+LightBounds light_bounds_one(const LightClusters &clusters, const PointLight &light,
+                             const Mat4 &view, float scale_x, float scale_y) {
+    Vec3 p = view * light.position;
+    float r = light.radius;
+    float depth = -p.z;
+    float z_min = std::max(depth - r, clusters.near);
+    float z_max = std::max(depth + r, clusters.near);
+    float left = std::min((p.x - r) / z_min, (p.x - r) / z_max) * scale_x;
+    float right = std::max((p.x + r) / z_min, (p.x + r) / z_max) * scale_x;
+    float bottom = std::min((p.y - r) / z_min, (p.y - r) / z_max) * scale_y;
+    float top = std::max((p.y + r) / z_min, (p.y + r) / z_max) * scale_y;
+    return to_bounds(clusters, depth - r, depth + r, left, right, bottom, top);
+}
+
+#ifdef LIGHTS_X86
+
+// Same as light_bounds_one on 4 lights
+void light_bounds_sse(LightClusters &clusters, const std::vector<PointLight> &lights, int begin,
+                      const Mat4 &view, float scale_x, float scale_y) {
+    const PointLight *l = &lights[begin];
+    __m128 x = _mm_setr_ps(l[0].position.x, l[1].position.x, l[2].position.x, l[3].position.x);
+    __m128 y = _mm_setr_ps(l[0].position.y, l[1].position.y, l[2].position.y, l[3].position.y);
+    __m128 z = _mm_setr_ps(l[0].position.z, l[1].position.z, l[2].position.z, l[3].position.z);
+    __m128 r = _mm_setr_ps(l[0].radius, l[1].radius, l[2].radius, l[3].radius);
+
+    auto row = [&](int i) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(view.val(i, 0)), x),
+                                     _mm_mul_ps(_mm_set1_ps(view.val(i, 1)), y)),
+                          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(view.val(i, 2)), z),
+                                     _mm_set1_ps(view.val(i, 3))));
+    };
+    __m128 px = row(0);
+    __m128 py = row(1);
+    __m128 depth = _mm_sub_ps(_mm_setzero_ps(), row(2));
+
+    __m128 near = _mm_set1_ps(clusters.near);
+    __m128 depth_min = _mm_sub_ps(depth, r);
+    __m128 depth_max = _mm_add_ps(depth, r);
+    __m128 inv_min = _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(depth_min, near));
+    __m128 inv_max = _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(depth_max, near));
+    __m128 sx = _mm_set1_ps(scale_x);
+    __m128 sy = _mm_set1_ps(scale_y);
+
+    __m128 x0 = _mm_sub_ps(px, r), x1 = _mm_add_ps(px, r);
+    __m128 y0 = _mm_sub_ps(py, r), y1 = _mm_add_ps(py, r);
+    __m128 left =
+        _mm_mul_ps(_mm_min_ps(_mm_mul_ps(x0, inv_min), _mm_mul_ps(x0, inv_max)), sx);
+    __m128 right =
+        _mm_mul_ps(_mm_max_ps(_mm_mul_ps(x1, inv_min), _mm_mul_ps(x1, inv_max)), sx);
+    __m128 bottom =
+        _mm_mul_ps(_mm_min_ps(_mm_mul_ps(y0, inv_min), _mm_mul_ps(y0, inv_max)), sy);
+    __m128 top = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(y1, inv_min), _mm_mul_ps(y1, inv_max)), sy);
+
+    alignas(16) float out[6][4];
+    _mm_store_ps(out[0], depth_min);
+    _mm_store_ps(out[1], depth_max);
+    _mm_store_ps(out[2], left);
+    _mm_store_ps(out[3], right);
+    _mm_store_ps(out[4], bottom);
+    _mm_store_ps(out[5], top);
+    for (int lane = 0; lane < 4; ++lane) {
+        clusters.bounds[begin + lane] =
+            to_bounds(clusters, out[0][lane], out[1][lane], out[2][lane], out[3][lane],
+                      out[4][lane], out[5][lane]);
+    }
+}
+
+#endif
+
+void compute_light_bounds(LightClusters &clusters, const std::vector<PointLight> &lights,
+                          const Mat4 &view, const Mat4 &projection) {
+    MemoryScope scope(MemoryTag::Render);
+    near_far(projection, clusters.near, clusters.far);
+    clusters.slice_scale = cluster_slices / std::log(clusters.far / clusters.near);
+    float scale_x = projection.val(0, 0);
+    float scale_y = projection.val(1, 1);
+
+    int n = lights.size();
+    clusters.bounds.resize(n);
+    int i = 0;
+#ifdef LIGHTS_X86
+    if (simd_level() != SimdLevel::Scalar) {
+        for (; i + 4 <= n; i += 4) {
+            light_bounds_sse(clusters, lights, i, view, scale_x, scale_y);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        clusters.bounds[i] = light_bounds_one(clusters, lights[i], view, scale_x, scale_y);
+    }
+}
+
+void assign_lights(LightClusters &clusters) {
+    clusters.visible.clear();
+    for (int l = 0; l < clusters.bounds.size(); ++l) {
+        if (clusters.bounds[l].slice_min <= clusters.bounds[l].slice_max) {
+            clusters.visible.push_back(l);
+        }
+    }
+    int n = clusters.visible.size();
+
+    // Starting threads every frame would cost more than the slices and allocate
+    for (int slice = 0; slice < cluster_slices; ++slice) {
+        std::vector<uint32_t> &offsets = clusters.offsets[slice];
+        std::vector<uint32_t> &indices = clusters.indices[slice];
+        std::fill(offsets.begin(), offsets.end(), 0);
+
+        // Counts the lights of each tile, then fills them in a second pass
+        for (uint32_t l : clusters.visible) {
+            const LightBounds &b = clusters.bounds[l];
+            if (slice < b.slice_min || slice > b.slice_max) {
+                continue;
+            }
+            for (int y = b.y_min; y <= b.y_max; ++y) {
+                for (int x = b.x_min; x <= b.x_max; ++x) {
+                    offsets[y * cluster_tiles_x + x + 1]++;
+                }
+            }
+        }
+        for (int t = 0; t < cluster_tiles; ++t) {
+            offsets[t + 1] += offsets[t];
+        }
+        indices.resize(offsets[cluster_tiles]);
+
+        // Cursor per tile, offsets[t] is back to the start of the tile at the end
+        for (int k = 0; k < n; ++k) {
+            const LightBounds &b = clusters.bounds[clusters.visible[k]];
+            if (slice < b.slice_min || slice > b.slice_max) {
+                continue;
+            }
+            for (int y = b.y_min; y <= b.y_max; ++y) {
+                for (int x = b.x_min; x <= b.x_max; ++x) {
+                    indices[offsets[y * cluster_tiles_x + x]++] = k;
+                }
+            }
+        }
+        for (int t = cluster_tiles; t > 0; --t) {
+            offsets[t] = offsets[t - 1];
+        }
+        offsets[0] = 0;
+    }
+}
+
+void build_clusters(LightClusters &clusters, const std::vector<PointLight> &lights,
+                    const Mat4 &view, const Mat4 &projection) {
+    MemoryScope scope(MemoryTag::Render);
+    compute_light_bounds(clusters, lights, view, projection);
+    assign_lights(clusters);
+}
+
+bool bind_clusters(const LightClusters &clusters, const std::vector<PointLight> &lights,
+                   StreamBuffer &stream, int width, int height) {
+    long alignment = stream.storage_alignment;
+
+    // An empty storage buffer cannot be bound, there is always at least one light and one index
+    long lights_size = std::max<long>(clusters.visible.size(), 1) * sizeof(GpuLight);
+    StreamAllocation lights_allocation = allocate(stream, lights_size, alignment);
+    if (!lights_allocation.data) {
+        return false;
+    }
+    auto *gpu_lights = (GpuLight *)lights_allocation.data;
+    for (int i = 0; i < clusters.visible.size(); ++i) {
+        const PointLight &light = lights[clusters.visible[i]];
+        gpu_lights[i] = {{light.position.x, light.position.y, light.position.z, light.radius},
+                         {light.color.x, light.color.y, light.color.z, 1}};
+    }
+    commit(stream, lights_allocation);
+
+    long clusters_size = sizeof(GpuClustersHeader) + cluster_count * sizeof(GpuClusterRange);
+    StreamAllocation clusters_allocation = allocate(stream, clusters_size, alignment);
+    if (!clusters_allocation.data) {
+        return false;
+    }
+    auto *header = (GpuClustersHeader *)clusters_allocation.data;
+    *header = {{clusters.near, clusters.slice_scale, (float)cluster_tiles_x / width,
+                (float)cluster_tiles_y / height}};
+    auto *ranges = (GpuClusterRange *)(header + 1);
+    uint32_t base = 0;
+    for (int slice = 0; slice < cluster_slices; ++slice) {
+        const std::vector<uint32_t> &offsets = clusters.offsets[slice];
+        for (int t = 0; t < cluster_tiles; ++t) {
+            ranges[slice * cluster_tiles + t] = {base + offsets[t], offsets[t + 1] - offsets[t]};
+        }
+        base += clusters.indices[slice].size();
+    }
+    commit(stream, clusters_allocation);
+
+    long indices_size = std::max<long>(base, 1) * sizeof(uint32_t);
+    StreamAllocation indices_allocation = allocate(stream, indices_size, alignment);
+    if (!indices_allocation.data) {
+        return false;
+    }
+    auto *indices = (uint32_t *)indices_allocation.data;
+    for (const std::vector<uint32_t> &slice_indices : clusters.indices) {
+        std::memcpy(indices, slice_indices.data(), slice_indices.size() * sizeof(uint32_t));
+        indices += slice_indices.size();
+    }
+    commit(stream, indices_allocation);
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, lights_binding, stream.buffer,
+                      lights_allocation.offset, lights_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, clusters_binding, stream.buffer,
+                      clusters_allocation.offset, clusters_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, light_indices_binding, stream.buffer,
+                      indices_allocation.offset, indices_size);
+    render_stats().lights = clusters.visible.size();
+    render_stats().light_indices = base;
+    return true;
+}
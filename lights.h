@@ -0,0 +1,72 @@
+#pragma once
+
+#include "grid.h"
+#include "maths.h"
+#include "stream_buffer.h"
+
+#include <cstdint>
+#include <vector>
+
+// Clustered forward shading: the view frustum is split in tiles on screen and in slices in depth,
+// exponentially spaced so that clusters far away are not much longer than they are wide. Each
+// frame the lights are assigned to the clusters they overlap on the CPU, the fragment shader then
+// only loops over the lights of its cluster. Needs storage buffers (GL 4.3), the same sizes are in
+// phong_fragment.glsl.
+
+constexpr int cluster_tiles_x = 16;
+constexpr int cluster_tiles_y = 9;
+constexpr int cluster_slices = 24;
+constexpr int cluster_tiles = cluster_tiles_x * cluster_tiles_y;
+constexpr int cluster_count = cluster_tiles * cluster_slices;
+
+// Storage buffer bindings, 0 is the draws of the static world
+constexpr unsigned int lights_binding = 1;
+constexpr unsigned int clusters_binding = 2;
+constexpr unsigned int light_indices_binding = 3;
+
+struct PointLight {
+    Vec3 position;
+    Vec3 color;
+    float radius; // no light beyond
+};
+
+// Clusters covered by a light, empty when slice_min > slice_max
+struct LightBounds {
+    int slice_min, slice_max;
+    int x_min, x_max;
+    int y_min, y_max;
+};
+
+struct LightClusters {
+    bool supported = false;
+    // Parameters of the view the clusters were built for
+    float near = 0;
+    float far = 0;
+    float slice_scale = 0; // slices per unit of log(depth / near)
+    std::vector<LightBounds> bounds;
+    // Lights that reach at least one cluster, the only ones uploaded. The indices are into it.
+    std::vector<uint32_t> visible;
+    // Per slice, start of the lights of each tile in indices (cluster_tiles + 1) and the lights
+    std::vector<std::vector<uint32_t>> offsets;
+    std::vector<std::vector<uint32_t>> indices;
+};
+
+LightClusters make_light_clusters();
+
+// Torches along the walls of the maze and a light on the end cell.
+std::vector<PointLight> make_torches(const Grid &grid);
+
+// Bounds in clusters of the lights for the view, 4 lights at a time with SSE when available.
+void compute_light_bounds(LightClusters &clusters, const std::vector<PointLight> &lights,
+                          const Mat4 &view, const Mat4 &projection);
+
+// Assigns the lights to the clusters, one slice at a time.
+void assign_lights(LightClusters &clusters);
+
+void build_clusters(LightClusters &clusters, const std::vector<PointLight> &lights,
+                    const Mat4 &view, const Mat4 &projection);
+
+// Writes the visible lights and the clusters to the stream buffer and binds them for this frame.
+// False when the stream buffer is full, the frame must then be drawn without clustered lights.
+bool bind_clusters(const LightClusters &clusters, const std::vector<PointLight> &lights,
+                   StreamBuffer &stream, int width, int height);
@@ -0,0 +1,164 @@
+#include "line_of_sight.h"
+
+#include "memory.h"
+#include "parallel.h"
+#include "raycast.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LINE_OF_SIGHT_X86
+#endif
+
+// The line is walked in steps of whole cells along x and z with the fraction s of the line where
+// it leaves each cell, (i + 0.5) / n for the i-th boundary of the n crossed along an axis. A tie
+// is a corner. The fractions are divisions of exact integers in both implementations so that ties
+// are found the same way.
+
+OcclusionMap make_occlusion_map(const Grid &grid) {
+    MemoryScope scope(MemoryTag::Grid);
+    OcclusionMap map;
+    map.rows = grid.rows;
+    map.cols = grid.cols;
+    map.heights.resize(grid.cells.size());
+    parallel_for(0, grid.cells.size(), [&](int index) { update_occlusion_map(map, grid, index); },
+                 4096);
+    return map;
+}
+
+// The center is on the slab of walls and hedges
+void update_occlusion_map(OcclusionMap &map, const Grid &grid, int index) {
+    map.heights[index] = cell_height(grid.cells[index], 0.5f, 0.5f);
+}
+
+bool line_of_sight(const OcclusionMap &map, int from, float from_height, int to, float to_height) {
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+    int row = from / map.cols;
+    int col = from % map.cols;
+    int nx = std::abs(to % map.cols - col);
+    int ny = std::abs(to / map.cols - row);
+    int step_x = to % map.cols > col ? 1 : -1;
+    int step_y = to / map.cols > row ? map.cols : -map.cols;
+    float dh = to_height - from_height;
+
+    int cell = from;
+    float s = 0;
+    for (int ix = 0, iy = 0; ix < nx || iy < ny;) {
+        float tx = nx ? (ix + 0.5f) / nx : infinity;
+        float ty = ny ? (iy + 0.5f) / ny : infinity;
+        float t = std::min(tx, ty);
+        // The line is lowest over the cell where it enters or leaves it
+        float h = from_height + dh * t;
+        if (cell != from && map.heights[cell] > std::min(from_height + dh * s, h)) {
+            return false;
+        }
+        bool x = tx <= ty;
+        bool y = ty <= tx;
+        if (x && y && (map.heights[cell + step_x] > h || map.heights[cell + step_y] > h)) {
+            return false;
+        }
+        cell += (x ? step_x : 0) + (y ? step_y : 0);
+        ix += x;
+        iy += y;
+        s = t;
+    }
+    return true;
+}
+
+#ifdef LINE_OF_SIGHT_X86
+
+__m128 gather_heights(const OcclusionMap &map, __m128i cells) {
+    alignas(16) int i[4];
+    _mm_store_si128((__m128i *)i, cells);
+    return _mm_setr_ps(map.heights[i[0]], map.heights[i[1]], map.heights[i[2]],
+                       map.heights[i[3]]);
+}
+
+// Same as line_of_sight on 4 targets, lanes that are done or blocked stop moving. Divisions by 0
+// give infinity like in the scalar version.
+void line_of_sight_sse(const OcclusionMap &map, int from, float from_height, const int *targets,
+                       const float *target_heights, uint8_t *visible) {
+    int row = from / map.cols;
+    int col = from % map.cols;
+    alignas(16) int nx[4], ny[4], step_x[4], step_y[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        int to = targets[lane];
+        nx[lane] = std::abs(to % map.cols - col);
+        ny[lane] = std::abs(to / map.cols - row);
+        step_x[lane] = to % map.cols > col ? 1 : -1;
+        step_y[lane] = to / map.cols > row ? map.cols : -map.cols;
+    }
+    __m128 n_x = _mm_cvtepi32_ps(_mm_load_si128((__m128i *)nx));
+    __m128 n_y = _mm_cvtepi32_ps(_mm_load_si128((__m128i *)ny));
+    __m128i sx = _mm_load_si128((__m128i *)step_x);
+    __m128i sy = _mm_load_si128((__m128i *)step_y);
+    __m128 h0 = _mm_set1_ps(from_height);
+    __m128 dh = _mm_sub_ps(_mm_loadu_ps(target_heights), h0);
+    __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.f);
+
+    __m128i cell = _mm_set1_epi32(from);
+    __m128 ix = _mm_setzero_ps(), iy = _mm_setzero_ps(), s = _mm_setzero_ps();
+    __m128 blocked = _mm_setzero_ps();
+    for (bool first = true;; first = false) {
+        __m128 active = _mm_andnot_ps(blocked, _mm_or_ps(_mm_cmplt_ps(ix, n_x),
+                                                         _mm_cmplt_ps(iy, n_y)));
+        if (!_mm_movemask_ps(active)) {
+            break;
+        }
+        __m128 tx = _mm_div_ps(_mm_add_ps(ix, half), n_x);
+        __m128 ty = _mm_div_ps(_mm_add_ps(iy, half), n_y);
+        __m128 t = _mm_min_ps(tx, ty);
+        __m128 h = _mm_add_ps(h0, _mm_mul_ps(dh, t));
+        if (!first) {
+            __m128 lowest = _mm_min_ps(_mm_add_ps(h0, _mm_mul_ps(dh, s)), h);
+            blocked = _mm_or_ps(blocked, _mm_and_ps(active, _mm_cmpgt_ps(gather_heights(map, cell),
+                                                                         lowest)));
+        }
+        __m128 x = _mm_and_ps(active, _mm_cmple_ps(tx, ty));
+        __m128 y = _mm_and_ps(active, _mm_cmple_ps(ty, tx));
+        __m128 corner = _mm_and_ps(x, y);
+        if (_mm_movemask_ps(corner)) {
+            __m128i corner_mask = _mm_castps_si128(corner);
+            __m128i x_side = _mm_add_epi32(cell, _mm_and_si128(corner_mask, sx));
+            __m128i y_side = _mm_add_epi32(cell, _mm_and_si128(corner_mask, sy));
+            __m128 side_x = gather_heights(map, x_side);
+            __m128 side_y = gather_heights(map, y_side);
+            __m128 hidden = _mm_or_ps(_mm_cmpgt_ps(side_x, h), _mm_cmpgt_ps(side_y, h));
+            blocked = _mm_or_ps(blocked, _mm_and_ps(corner, hidden));
+        }
+        cell = _mm_add_epi32(cell, _mm_and_si128(_mm_castps_si128(x), sx));
+        cell = _mm_add_epi32(cell, _mm_and_si128(_mm_castps_si128(y), sy));
+        ix = _mm_add_ps(ix, _mm_and_ps(x, one));
+        iy = _mm_add_ps(iy, _mm_and_ps(y, one));
+        s = _mm_or_ps(_mm_and_ps(active, t), _mm_andnot_ps(active, s));
+    }
+
+    int mask = _mm_movemask_ps(blocked);
+    for (int lane = 0; lane < 4; ++lane) {
+        visible[lane] = !(mask & (1 << lane));
+    }
+}
+
+#endif
+
+void line_of_sight(const OcclusionMap &map, int from, float from_height,
+                   const std::vector<int> &targets, const std::vector<float> &target_heights,
+                   std::vector<uint8_t> &visible) {
+    int n = targets.size();
+    visible.resize(n);
+    int i = 0;
+#ifdef LINE_OF_SIGHT_X86
+    if (simd_level() != SimdLevel::Scalar) {
+        for (; i + 4 <= n; i += 4) {
+            line_of_sight_sse(map, from, from_height, &targets[i], &target_heights[i],
+                              &visible[i]);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        visible[i] = line_of_sight(map, from, from_height, targets[i], target_heights[i]);
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "grid.h"
+
+#include <cstdint>
+#include <vector>
+
+// Visibility between cells without the triangles. Each cell is a box as high as the tallest thing
+// in it, and the segment between two points above the centers of two cells is blocked when it
+// passes below the top of a box it touches (a supercover of the cells, where passing through a
+// corner touches the cells on both sides). Thin walls fill their whole cell, so the test is
+// conservative: what it sees is visible, some visible cells are missed. With both heights at 0 it
+// is the 2D test, anything standing in a cell blocks.
+
+struct OcclusionMap {
+    int rows = 0;
+    int cols = 0;
+    std::vector<float> heights;
+};
+
+OcclusionMap make_occlusion_map(const Grid &grid);
+void update_occlusion_map(OcclusionMap &map, const Grid &grid, int index);
+
+// The cells at both ends do not block, heights are above the ground.
+bool line_of_sight(const OcclusionMap &map, int from, float from_height, int to, float to_height);
+
+// Same from one cell to each of the targets, 4 lines are walked at once with SSE.
+void line_of_sight(const OcclusionMap &map, int from, float from_height,
+                   const std::vector<int> &targets, const std::vector<float> &target_heights,
+                   std::vector<uint8_t> &visible);
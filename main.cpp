@@ -3,15 +3,35 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <cmath>
+#include <cstdio>
+#include <future>
 #include <optional>
+#include <stdexcept>
 #include <unordered_map>
 #include <utility>
 
 #include "axes.h"
+#include "bake.h"
 #include "buffer.h"
+#include "debug_draw.h"
+#include "frustum.h"
+#include "gpu_timer.h"
+#include "grid.h"
+#include "grid_chunks.h"
+#include "grid_graph.h"
+#include "level_file.h"
+#include "level_generator.h"
+#include "level_watcher.h"
+#include "lights.h"
 #include "logging.h"
+#include "memory.h"
 #include "mesh2.h"
+#include "overlay.h"
 #include "physics.h"
+#include "raycast.h"
+#include "render_queue.h"
+#include "static_world.h"
+#include "stream_buffer.h"
 #include "timer.h"
 
 int window_width = 1024;
@@ -22,18 +42,21 @@ struct DebugControls {
     bool wireframe = false;
     bool draw_axes = true;
     bool show_normals = false;
+    bool print_stats = false;
+    bool show_overlay = false;
+    bool draw_bounding_boxes = false;
 };
 
-struct Teleportation {
-    int target;
+struct FrameStats {
+    uint64_t allocations = 0;
+    float cpu_ms = 0;
+    float time_since_print = 0;
+    RenderStats render;
 };
 
-struct Entity {
-    Mesh mesh;
-    BasicRenderingBuffer rendering;
-    Vec3 color;
-    Mat4 transform;
-    Vec3 origin;
+struct Teleportation {
+    int target;
+    Entity highlight;
 };
 
 struct Editor {
@@ -44,34 +67,25 @@ struct Editor {
     Vec3 selected_point;
 };
 
-struct CellProperties {
-    int axis;
+// Level given on the command line, loaded from a file when nothing is generated
+struct LevelOptions {
+    bool generate = false;
+    LevelParameters param;
+    std::string path = "levels/level1.txt";
+    std::string name = "levels/level1"; // of the cache files
 };
 
-struct Cell {
-    enum Type {
-        Start,
-        End,
-        Floor,
-        Hole, // axis: X, Y or Z
-        Wall,
-        Mirror, // normal vector will define the orientation
-        Hedge,
-        Platform,
-        RaisedPlatform
-    };
-    Type type = Type::Floor;
-    CellProperties prop;
-    Entity entity;
-};
+// Averaged over the last frames, the FPS of a single frame is too noisy to read
+class FPSCounter {
+  public:
+    FPSCounter() : m_average_dt(1) {}
 
-struct Grid {
-    //    std::vector<Entity> entities;
-    std::vector<Cell> cells;
-    int rows;
-    int cols;
-    int start;
-    int end;
+    void tick(float dt) { m_average_dt += (dt - m_average_dt) * 0.05f; }
+
+    float fps() const { return 1.f / m_average_dt; }
+
+  private:
+    float m_average_dt;
 };
 
 struct World {
@@ -79,12 +93,34 @@ struct World {
     Teleportation teleportation;
     Camera camera;
     Axes axes;
+    DebugDraw debug_draw;
+    RenderQueue render_queue;
+    CommandBackend command_backend;
+    GridChunks grid_chunks;
+    StaticWorld static_world;
+    StreamBuffer stream;
+    std::vector<PointLight> lights;
+    int lights_version = -1;
+    LightClusters light_clusters;
+    bool lights_bound = false; // the clusters of this frame are bound
+    BakedLighting baked;
+    int baked_version = -1;
     DebugControls debug_controls;
     Editor editor;
     Grid grid;
+    LevelWatcher level_watcher;
+    bool level_dirty = false;
+    std::future<LevelReload> level_reload;
+    GridGraph graph;
+    int graph_version = -1;
+    FrameStats stats;
+    GpuTimer gpu_timer;
+    FPSCounter fps_counter;
+    Overlay overlay;
 };
 
 World world;
+LevelOptions level_options;
 
 Entity make_floor() {
     Entity body;
@@ -96,21 +132,6 @@ Entity make_floor() {
     return body;
 }
 
-Entity make_entity(Mesh mesh, Vec3 color = {0.5, 0.5, 0.5}) {
-    Entity body;
-    body.mesh = mesh;
-    body.color = color;
-    body.transform = eye();
-    body.rendering = init_rendering(mesh);
-    body.origin = {0, 0, 0};
-    return body;
-}
-
-struct Ray {
-    Vec3 origin;
-    Vec3 direction;
-};
-
 struct IntersectInfo {
     Vec3 point;
     int entity_index;
@@ -121,52 +142,11 @@ template <typename T> bool contains(const std::vector<T> &v, const T &val) {
 }
 
 std::optional<IntersectInfo> find_point_on_grid(const Ray &ray) {
-    std::optional<IntersectInfo> info;
-    float min_t = std::numeric_limits<float>::max();
-    for (int i = 0; i < world.grid.cells.size(); ++i) {
-        const Cell &cell = world.grid.cells[i];
-        Mat4 model_transform = cell.entity.transform;
-        Mat4 normal_transform = transpose(invert(model_transform));
-        Mesh mesh = cell.entity.mesh;
-        int n_faces = mesh.vertices.size() / 3;
-        for (int face_index = 0; face_index < n_faces; ++face_index) {
-            // https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/ray-triangle-intersection-geometric-solution
-            Vec3 normal = normal_transform * mesh.normals[face_index * 3];
-            if (dot(normal, ray.direction) >= 0) {
-                // triangle is facing away from ray
-                continue;
-            }
-
-            Vec3 v0 = model_transform * mesh.vertices[face_index * 3];
-            Vec3 v1 = model_transform * mesh.vertices[face_index * 3 + 1];
-            Vec3 v2 = model_transform * mesh.vertices[face_index * 3 + 2];
-
-            auto plane_distance = dot(normal, v0);
-            float t = -(dot(normal, ray.origin) - plane_distance) / dot(normal, ray.direction);
-            if (t <= 0) {
-                // triangle is behind the ray
-                continue;
-            }
-
-            Vec3 point_intersect = ray.origin + ray.direction * t;
-            Vec3 e0 = v1 - v0;
-            Vec3 e1 = v2 - v1;
-            Vec3 e2 = v0 - v2;
-            Vec3 c0 = point_intersect - v0;
-            Vec3 c1 = point_intersect - v1;
-            Vec3 c2 = point_intersect - v2;
-            if (dot(normal, cross(e0, c0)) > 0 && dot(normal, cross(e1, c1)) > 0 &&
-                dot(normal, cross(e2, c2)) > 0) {
-                // point is inside the triangle
-                if (t < min_t) {
-                    min_t = t;
-                    info = IntersectInfo{.point = point_intersect, .entity_index = i};
-                }
-            } else {
-            }
-        }
+    RayHit hit = raycast(world.grid, ray);
+    if (hit.triangle < 0) {
+        return std::nullopt;
     }
-    return info;
+    return IntersectInfo{.point = ray.origin + ray.direction * hit.t, .entity_index = hit.id};
 }
 
 // void confirm_teleportation() {
@@ -191,13 +171,12 @@ std::optional<IntersectInfo> find_point_on_grid(const Ray &ray) {
 //     }
 // }
 
-void draw_middle_point() {
-    glPointSize(5);
-    glBegin(GL_POINTS);
-    glColor3d(1, 1, 1);
-    glVertex3d(0, 0, 0);
-    glEnd();
-}
+void draw_middle_point() { screen_point(world.debug_draw, 0, 0, {1.f, 1.f, 1.f}); }
+
+constexpr float player_radius = 0.3f;
+// High enough to walk onto a platform
+constexpr float player_step_height = 0.55f;
+constexpr float player_fall_speed = 10.f;
 
 void update_camera_position(Camera &camera, float dt) {
     Vec3 velocity;
@@ -223,44 +202,18 @@ void update_camera_position(Camera &camera, float dt) {
     if (camera.controls.move_faster)
         velocity *= 2.f;
 
-    //    velocity.y -= 100 * dt; // Fake gravity, should accumulate
+    // Falls at a constant speed, flying up holds the player in the air
+    if (!camera.controls.move_up) {
+        velocity.y -= player_fall_speed;
+    }
     velocity *= dt;
 
-    //    float radius = 0.3;
-    //    if (norm(velocity) > 0) {
-    //        for (int entity_index = 0; entity_index < world.entities.size(); ++entity_index) {
-    //            const Mesh &mesh = world.entities[entity_index].mesh;
-    //            Mat4 model_transform = world.entities[entity_index].transform;
-    //            Mat4 normal_transform = transpose(invert(model_transform));
-    //            for (int face_index = 0; face_index < mesh.vertices.size() / 3; ++face_index) {
-    //                Vec3 position = camera.position() + velocity;
-    //                Vec3 v0 = model_transform * mesh.vertices[face_index * 3];
-    //                Vec3 v1 = model_transform * mesh.vertices[face_index * 3 + 1];
-    //                Vec3 v2 = model_transform * mesh.vertices[face_index * 3 + 2];
-    //                Vec3 n = normal_transform * mesh.normals[face_index * 3];
-    //
-    //                Vec3 face_center = centroid(v0, v1, v2);
-    //                float circumsphere_radius = norm(v0 - face_center);
-    //                if (norm(position - face_center) < circumsphere_radius) {
-    //                    Vec3 p0 = position - v0;
-    //                    Vec3 p1 = position - v1;
-    //                    Vec3 p2 = position - v2;
-    //                    if (dot(p0, v1 - v0) > 0 && dot(p1, v2 - v1) > 0 && dot(p2, v0 - v2) > 0)
-    //                    {
-    //                        float distance = dot(p0, n);
-    //                        if (distance - radius < 0 &&
-    //                            distance > 0 // Assumption that we will never be inside an
-    //                            object...
-    //                        ) {
-    //                            velocity -= n * (distance - radius);
-    //                        }
-    //                    }
-    //                }
-    //            }
-    //        }
-    //    }
-
-    camera.set_position(camera.position() + velocity);
+    // The player is a sphere resting on the ground, the camera is 1 above the ground
+    Sphere player = {.pos = camera.position() - Vec3{0.f, 1.f - player_radius, 0.f},
+                     .radius = player_radius};
+    Vec3 center = move_character(world.grid.collision, world.grid.heightfield, player, velocity,
+                                 player_step_height);
+    camera.set_position(center - Vec3{0.f, player_radius, 0.f});
 }
 
 std::pair<float, float> screen_to_clip(float x, float y) {
@@ -333,29 +286,6 @@ std::optional<Vec3> find_point_on_plane(Ray ray) {
     return ray.origin + ray.direction * t;
 }
 
-Vec3 coord_at(const Grid &grid, int index) {
-    float row = std::floor(index / grid.cols);
-    float col = index % grid.cols;
-    Vec3 cell_origin = {0.5f, 0.f, -0.5f};
-    return Vec3{col, 0.f, -row} + cell_origin;
-}
-
-int index_at(const Grid &grid, int row, int col) { return row * grid.cols + col; }
-
-Vec3 coord_at(const Grid &grid, int row, int col) {
-    return coord_at(grid, index_at(grid, row, col));
-}
-
-int index_at(const Grid &grid, Vec3 coord) {
-    int col = std::floor(coord.x);
-    int row = std::floor(-coord.z);
-    return index_at(grid, row, col);
-}
-
-bool can_teleport_here(Cell::Type type) {
-    return (type == Cell::Type::Floor) || (type == Cell::Type::Start) || (type == Cell::Type::End);
-}
-
 void update_teleportation() {
     Ray ray = {.origin = world.camera.position(), .direction = world.camera.direction()};
     auto point = find_point_on_grid(ray);
@@ -366,159 +296,304 @@ void update_teleportation() {
     }
 }
 
+// Center of the cell, on top of what is there
+Vec3 ground_at(const Grid &grid, int index) {
+    Vec3 position = coord_at(grid, index);
+    position.y = height_at(grid.heightfield, position);
+    return position;
+}
+
 void confirm_teleportation() {
     if (world.teleportation.target >= 0) {
         log(world.teleportation.target);
-        world.camera.set_position(coord_at(world.grid, world.teleportation.target));
+        world.camera.set_position(ground_at(world.grid, world.teleportation.target));
+        int left = world.graph.distance[world.teleportation.target];
+        log(left >= 0 ? std::to_string(left) + " teleports to the end" : "the end is out of reach");
     }
 }
 
-RenderingParameters render_params(const Entity &entity) {
-    return {.color = entity.color,
-            .model_transform = entity.transform,
-            .view_transform = world.camera.view(),
-            .perspective_transform = world.camera.projection(),
+// Linked again when the grid changes, and checked that the end can be reached from the start
+void update_graph() {
+    if (world.graph_version == world.grid.version) {
+        return;
+    }
+    world.graph = make_grid_graph(world.grid);
+    world.graph_version = world.grid.version;
+    int distance = world.graph.distance[world.grid.start];
+    if (distance < 0) {
+        log("the end cannot be reached from the start");
+    } else {
+        log("the end is " + std::to_string(distance) + " teleports from the start");
+    }
+}
+
+FrameUniforms frame_uniforms() {
+    uint32_t features = Specular;
+    if (world.baked.texture) {
+        features |= BakedLight;
+    }
+    if (world.lights_bound) {
+        features |= ClusteredLights;
+    }
+    return {.view = world.camera.view(),
+            .projection = world.camera.projection(),
             .camera_position = world.camera.position(),
-            .show_normals = world.debug_controls.show_normals};
+            .bake_scale = bake_scale(world.grid),
+            .features = world.debug_controls.show_normals ? ShowNormals : features};
+}
+
+// Baked again only when the geometry changed, from the cache file when it was baked before
+void update_baked_lighting() {
+    if (world.baked_version == world.grid.version) {
+        return;
+    }
+    world.baked_version = world.grid.version;
+    if (world.baked.texture && world.baked.hash == geometry_hash(world.grid)) {
+        return;
+    }
+    free_baked_lighting(world.baked);
+    if (!bake_fits(world.grid)) {
+        log("the level is too large to bake its lighting");
+        return;
+    }
+    world.baked = baked_lighting(world.grid, level_options.name + ".bake");
+    upload(world.baked);
+}
+
+// Torches follow the walls, they are placed again when the grid changes
+void update_lights() {
+    world.lights_bound = false;
+    if (!world.light_clusters.supported) {
+        return;
+    }
+    if (world.lights_version != world.grid.version) {
+        world.lights = make_torches(world.grid);
+        world.lights_version = world.grid.version;
+    }
+    build_clusters(world.light_clusters, world.lights, world.camera.view(),
+                   world.camera.projection());
+    world.lights_bound = bind_clusters(world.light_clusters, world.lights, world.stream,
+                                       window_width, window_height);
 }
 
 void draw_grid() {
-    for (int i = 0; i < world.grid.cells.size(); ++i) {
-        const Entity &entity = world.grid.cells[i].entity;
-        RenderingParameters params = render_params(entity);
-        if (world.teleportation.target == i) {
-            params.color = {1, 1, 1};
-        }
-        draw(entity.rendering, params);
+    FrameUniforms frame = frame_uniforms();
+    Frustum frustum = make_frustum(frame.projection * frame.view);
+    // Compiled here on the first use, the workers only read it
+    const Shader &phong = variant(phong_shader(), frame.features);
+
+    if (world.static_world.supported) {
+        update_static_world(world.static_world, world.grid);
+        draw(world.static_world, world.stream, frustum, frame.features);
+    } else {
+        update_grid_chunks(world.grid_chunks, world.grid);
+        record(world.grid_chunks, world.grid, frustum, phong);
+        replay(world.command_backend, world.grid_chunks);
+    }
+
+    // Blocks cover many cells, the target cell is drawn again on top of its block
+    if (world.teleportation.target >= 0) {
+        const Entity &highlight = world.teleportation.highlight;
+        const Mat4 &cell_transform = world.grid.cells[world.teleportation.target].entity.transform;
+        submit(world.render_queue, RenderPass::Decal, phong, highlight.rendering,
+               translate(cell_transform, {0.f, 0.001f, 0.f}), highlight.color);
     }
+
+    execute(world.render_queue, world.command_backend);
+}
+
+void draw_overlay() {
+    OverlayStats stats = {.fps = world.fps_counter.fps(),
+                          .cpu_ms = world.stats.cpu_ms,
+                          .allocations = world.stats.allocations,
+                          .render = world.stats.render,
+                          .heap_bytes = 0,
+                          .gpu_bytes = 0,
+                          .gpu_timer = &world.gpu_timer};
+    for (int i = 0; i < (int)MemoryTag::Count; ++i) {
+        MemoryStats memory = memory_stats((MemoryTag)i);
+        stats.heap_bytes += memory.bytes;
+        stats.gpu_bytes += memory.gpu_bytes;
+    }
+    draw(world.overlay, world.stream, stats, window_width, window_height);
 }
 
 void display() {
     glClearColor(0, 0, 0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Before the features of the frame are chosen, they depend on the bake and on the lights
+    update_baked_lighting();
+    update_lights();
+    FrameUniforms frame = frame_uniforms();
+    bind_frame_uniforms(world.stream, frame);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, world.baked.texture);
+
+    {
+        GpuPass pass(world.gpu_timer, "grid");
+        draw_grid();
+    }
 
     if (world.debug_controls.draw_axes) {
-        draw(world.axes, world.camera);
+        draw(world.axes, world.debug_draw);
     }
 
-    draw_grid();
+    if (world.debug_controls.draw_bounding_boxes) {
+        for (const auto &[id, block] : world.grid.blocks) {
+            aabb(world.debug_draw, block.min, block.max, {1.f, 1.f, 0.f});
+        }
+    }
 
     if (world.editor.enabled) {
-        glPointSize(5);
-        glBegin(GL_POINTS);
-        glColor3d(1, 1, 1);
         auto [xd, yd] = screen_to_clip(world.editor.mouse_pos_x, world.editor.mouse_pos_y);
-        glVertex3d(xd, yd, 0);
-        glEnd();
+        screen_point(world.debug_draw, xd, yd, {1.f, 1.f, 1.f});
     } else {
         //        draw_teleportation();
     }
 
     draw_middle_point();
-}
 
-void update(float dt) {
-    if (!world.editor.enabled) {
-        //        update_camera_position(world.camera, dt);
-        update_fpv_view(world.camera);
-        update_teleportation();
+    {
+        GpuPass pass(world.gpu_timer, "debug");
+        flush(world.debug_draw, world.stream);
+    }
+
+    if (world.debug_controls.show_overlay) {
+        draw_overlay();
     }
 }
 
-Entity make_entity_from_cell(Cell::Type type, CellProperties prop) {
-    switch (type) {
-    case Cell::Type::Floor:
-    case Cell::Type::Start:
-        return make_entity(floor_tile_mesh(1, 1), {0.1, 0.8, 0.1});
-    case Cell::Type::End:
-        return make_entity(floor_tile_mesh(1, 1), {0.1, 0.4, 0.5});
-    case Cell::Type::Wall: {
-        if (prop.axis == 0) {
-            return make_entity(rectangle_mesh(1, 5, 0.2));
-        } else {
-            return make_entity(rectangle_mesh(0.2, 5, 1));
-        }
+// The level file is read and diffed on a background thread once it was written, the changed cells
+// are linked and baked again there too. Only putting them in the grid and uploading the bake is
+// left to this thread. A reload that fails keeps the level.
+void update_level() {
+    world.level_dirty |= level_changed(world.level_watcher);
+    if (world.level_dirty && !world.level_reload.valid()) {
+        world.level_dirty = false;
+        // Those that are up to date, they are then only read until the reload is applied
+        const GridGraph *graph = world.graph_version == world.grid.version ? &world.graph : nullptr;
+        const BakedLighting *baked =
+            world.baked.texture && world.baked_version == world.grid.version ? &world.baked
+                                                                              : nullptr;
+        world.level_reload = std::async(std::launch::async, [graph, baked] {
+            LevelReload reload = prepare_reload(world.grid, level_options.path);
+            relink_and_rebake(reload, world.grid, graph, baked);
+            if (reload.baked) {
+                save_baked_lighting(*reload.baked, level_options.name + ".bake");
+            }
+            return reload;
+        });
     }
-    case Cell::Type::Hedge: {
-        if (prop.axis == 0) {
-            return make_entity(rectangle_mesh(1, 0.5, 0.2), {0.1, 0.5, 0.1});
-        } else if (prop.axis == 2) {
-            return make_entity(rectangle_mesh(0.2, 0.5, 1), {0.1, 0.5, 0.1});
-        }
+    if (!world.level_reload.valid() ||
+        world.level_reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
     }
-    case Cell::Type::Platform: {
-        return make_entity(rectangle_mesh(1, 0.5, 1), {0.1, 0.1, 0.8});
+
+    Timer timer;
+    LevelReload reload;
+    try {
+        reload = world.level_reload.get();
+    } catch (const std::exception &e) {
+        log(std::string("could not reload the level: ") + e.what());
+        return;
     }
-    case Cell::Type::RaisedPlatform: {
-        return make_entity(rectangle_mesh(1, 2, 1), {0.1, 0.1, 0.8});
+    apply_reload(world.grid, reload);
+    if (reload.resized) {
+        // Everything follows the new version of the grid
+        world.teleportation.target = -1;
+        world.camera.set_position(ground_at(world.grid, world.grid.start));
+        log("reloaded the whole level in " + std::to_string(timer.seconds_elapsed()) + " s");
+        return;
+    }
+    if (reload.graph) {
+        world.graph = std::move(*reload.graph);
+        world.graph_version = world.grid.version;
     }
+    if (reload.baked) {
+        world.baked.samples = std::move(reload.baked->samples);
+        world.baked.hash = reload.baked->hash;
+        upload(world.baked);
+        world.baked_version = world.grid.version;
     }
+    log("reloaded " + std::to_string(reload.changed.size()) + " cells in " +
+        std::to_string(timer.seconds_elapsed()) + " s");
 }
 
-void add_cell(Grid &grid, int row, int col, Cell::Type type, CellProperties prop = {}) {
-    Entity entity = make_entity_from_cell(type, prop);
-    entity.transform = translate(eye(), coord_at(grid, row, col));
-    Cell cell = {
-        .type = type,
-        .prop = prop,
-        .entity = entity,
-    };
-    grid.cells[index_at(grid, row, col)] = cell;
+void update(float dt) {
+    if (!world.editor.enabled) {
+        update_camera_position(world.camera, dt);
+        update_fpv_view(world.camera);
+        update_teleportation();
+    }
+    update_level();
+    update_graph();
 }
 
-Grid make_grid_from_definition(std::string def, int rows, int cols) {
-    Grid grid;
-    grid.rows = rows;
-    grid.cols = cols;
-    grid.cells.resize(rows * cols);
-
-    for (int row = 0; row < rows; ++row) {
-        for (int col = 0; col < cols; ++col) {
-            int index = row * cols + col;
-            std::string s = def.substr(index * 2, 2);
-
-            if (s == "  ") {
-                add_cell(grid, row, col, Cell::Type::Floor);
-            } else if (s == "==") {
-                add_cell(grid, row, col, Cell::Type::Wall, {.axis = 0});
-            } else if (s == "||") {
-                add_cell(grid, row, col, Cell::Type::Wall, {.axis = 2});
-            } else if (s == "--") {
-                add_cell(grid, row, col, Cell::Type::Hedge, {.axis = 0});
-            } else if (s == "| ") {
-                add_cell(grid, row, col, Cell::Type::Hedge, {.axis = 2});
-            } else if (s == "TT") {
-                add_cell(grid, row, col, Cell::Type::RaisedPlatform);
-            } else if (s == "__") {
-                add_cell(grid, row, col, Cell::Type::Platform);
-            } else if (s == "a ") {
-                add_cell(grid, row, col, Cell::Type::Start);
-                grid.start = index;
-            } else if (s == "z ") {
-                add_cell(grid, row, col, Cell::Type::End);
-                grid.end = index;
-            } else {
-                throw std::runtime_error("Unknown cell: '" + s + "' at location (" +
-                                         std::to_string(row) + ", " + std::to_string(col) + ")");
+// [--level <path>] or --generate maze|rooms|platforms [--size <rows>x<cols>] [--seed <n>]
+// [--region <cells>]
+LevelOptions parse_level_options(int argc, char **argv) {
+    LevelOptions options;
+    std::string kind;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            throw std::runtime_error("Missing value of " + arg);
+        }
+        std::string value = argv[++i];
+        if (arg == "--level") {
+            options.path = value;
+            size_t dot = value.find_last_of('.');
+            size_t slash = value.find_last_of('/');
+            bool extension = dot != std::string::npos &&
+                             (slash == std::string::npos || dot > slash);
+            options.name = extension ? value.substr(0, dot) : value;
+        } else if (arg == "--generate") {
+            options.generate = true;
+            options.param.kind = parse_level_kind(value);
+            kind = value;
+        } else if (arg == "--size") {
+            LevelParameters &param = options.param;
+            if (std::sscanf(value.c_str(), "%dx%d", &param.rows, &param.cols) != 2) {
+                throw std::runtime_error("Size should be <rows>x<cols>, got " + value);
             }
+        } else if (arg == "--seed") {
+            options.param.seed = std::stoull(value);
+        } else if (arg == "--region") {
+            options.param.region_size = std::stoi(value);
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
         }
     }
-    return grid;
+    if (options.generate) {
+        options.name = kind + "_" + std::to_string(options.param.rows) + "x" +
+                       std::to_string(options.param.cols) + "_" +
+                       std::to_string(options.param.seed);
+    }
+    return options;
 }
 
-Grid make_grid1() {
-    std::string def = "||============||"
-                      "||a   ||      ||"
-                      "||    ||      z "
-                      "||    |       ||"
-                      "||============||";
-    return make_grid_from_definition(def, 5, 8);
+Grid make_level() {
+    if (!level_options.generate) {
+        LevelFile level = load_level_file(level_options.path);
+        world.level_watcher = make_level_watcher(level_options.path);
+        return make_grid_from_definition(level.definition, level.rows, level.cols);
+    }
+    const LevelParameters &param = level_options.param;
+    return make_grid_from_definition(generate_definition(param), param.rows, param.cols);
 }
 
 void init() {
-    world.grid = make_grid1();
-    world.camera.set_position(coord_at(world.grid, world.grid.start));
+    init_gpu_timer(world.gpu_timer);
+    world.stream = make_stream_buffer();
+    world.light_clusters = make_light_clusters();
+    world.overlay = make_overlay();
+    world.static_world = make_static_world();
+    world.debug_draw = make_debug_draw();
+    world.grid = make_level();
+    world.camera.set_position(ground_at(world.grid, world.grid.start));
     world.axes = make_axes();
+    world.teleportation.highlight = make_entity(floor_tile_mesh(1, 1), {1, 1, 1});
+    world.teleportation.highlight.rendering = init_rendering(world.teleportation.highlight.mesh);
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
@@ -622,6 +697,22 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
         toggle_editor();
     }
+
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+        log(memory_report());
+    }
+
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        world.debug_controls.print_stats = !world.debug_controls.print_stats;
+    }
+
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS) {
+        world.debug_controls.show_overlay = !world.debug_controls.show_overlay;
+    }
+
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+        world.debug_controls.draw_bounding_boxes = !world.debug_controls.draw_bounding_boxes;
+    }
 }
 
 struct MouseDelta {
@@ -688,20 +779,31 @@ void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
     }
 }
 
-class FPSCounter {
-  public:
-    FPSCounter() : m_last_dt(1) {}
-
-    void tick(float dt) { m_last_dt = dt; }
 
-    float fps() const { return 1.f / m_last_dt; }
+// One line with the CPU time of the frame and the GPU time of each pass, nested passes are
+// indented
+std::string frame_stats_line() {
+    std::string line = "cpu " + std::to_string(world.stats.cpu_ms) + " ms, " +
+                       std::to_string(world.stats.allocations) + " allocations, gpu";
+    const GpuTimer &timer = world.gpu_timer;
+    for (int i = 0; i < timer.n_results; ++i) {
+        line += (i == 0 ? " " : ", ") + std::string(timer.results[i].depth, '>') +
+                timer.results[i].name + " " + std::to_string(timer.results[i].ms) + " ms";
+    }
+    return line;
+}
 
-  private:
-    float m_last_dt;
-};
+void print_frame_stats(float dt) {
+    world.stats.time_since_print += dt;
+    if (world.debug_controls.print_stats && world.stats.time_since_print >= 1) {
+        log(frame_stats_line());
+        world.stats.time_since_print = 0;
+    }
+}
 
 int main(int argc, char **argv) {
     GLFWwindow *window;
+    level_options = parse_level_options(argc, argv);
 
     glfwInit();
     window_height = window_width / window_ratio;
@@ -722,21 +824,41 @@ int main(int argc, char **argv) {
     glewInit();
     init();
     auto timer = Timer();
-    auto fps_counter = FPSCounter();
 
     while (!glfwWindowShouldClose(window)) {
 
+        uint64_t allocations = allocation_count();
+
         auto dt = timer.tick();
+        world.fps_counter.tick(dt);
+        add_frame_time(world.overlay, dt * 1000);
+        begin_frame(world.gpu_timer);
+        begin_frame(world.stream);
         update(dt);
         display();
-
-        //        fps_counter.tick(dt);
-        //        log("FPS: " + std::to_string(fps_counter.fps()));
+        end_frame(world.stream);
+        end_frame(world.gpu_timer);
+        world.stats.cpu_ms = timer.seconds_elapsed() * 1000;
 
         glfwSwapBuffers(window);
         glfwPollEvents();
-    }
 
+        world.stats.allocations = allocation_count() - allocations;
+        // The overlay shows the counters of the previous frame while this one is drawn
+        world.stats.render = render_stats();
+        render_stats() = {};
+        print_frame_stats(dt);
+        reset(frame_arena());
+    }
+
+    free_level_watcher(world.level_watcher);
+    free_debug_draw(world.debug_draw);
+    free_static_world(world.static_world);
+    free_baked_lighting(world.baked);
+    free_overlay(world.overlay);
+    free_gpu_timer(world.gpu_timer);
+    free_stream_buffer(world.stream);
+    write_memory_report("memory.json");
     glfwTerminate();
 
     return 0;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -21,7 +22,7 @@ struct Vec4 {
 
 class Mat4 {
   public:
-    Mat4() { m_values.resize(16); }
+    Mat4() = default;
 
     float val(int i, int j) const { return m_values[i * cols() + j]; }
 
@@ -35,7 +36,8 @@ class Mat4 {
 
     int cols() const { return 4; }
 
-    std::vector<float> m_values;
+    // Inline so that matrices can be copied around every frame without allocating
+    std::array<float, 16> m_values{};
 };
 
 Vec3 operator+(const Vec3 &p, const Vec3 &q);
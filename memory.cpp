@@ -0,0 +1,206 @@
+#include "memory.h"
+
+#include "logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+std::atomic<uint64_t> allocations{0};
+
+uint64_t allocation_count() { return allocations.load(std::memory_order_relaxed); }
+
+struct TagCounters {
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> peak_bytes{0};
+    std::atomic<int64_t> allocations{0};
+    std::atomic<int64_t> gpu_bytes{0};
+    std::atomic<int64_t> gpu_peak_bytes{0};
+};
+
+TagCounters counters[(int)MemoryTag::Count];
+thread_local MemoryTag current_tag = MemoryTag::Other;
+
+void add_to_peak(std::atomic<int64_t> &value, std::atomic<int64_t> &peak, int64_t delta) {
+    int64_t now = value.fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t previous = peak.load(std::memory_order_relaxed);
+    while (now > previous && !peak.compare_exchange_weak(previous, now)) {
+    }
+}
+
+// Every allocation is preceded by its size and tag so that delete can account for it
+struct alignas(std::max_align_t) AllocationHeader {
+    size_t size;
+    MemoryTag tag;
+};
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto *header = static_cast<AllocationHeader *>(std::malloc(sizeof(AllocationHeader) + size));
+    if (!header) {
+        throw std::bad_alloc();
+    }
+    header->size = size;
+    header->tag = current_tag;
+    TagCounters &c = counters[(int)header->tag];
+    add_to_peak(c.bytes, c.peak_bytes, size);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    return header + 1;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept {
+    if (!p) {
+        return;
+    }
+    auto *header = static_cast<AllocationHeader *>(p) - 1;
+    TagCounters &c = counters[(int)header->tag];
+    c.bytes.fetch_sub(header->size, std::memory_order_relaxed);
+    c.allocations.fetch_sub(1, std::memory_order_relaxed);
+    std::free(header);
+}
+
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+const char *name(MemoryTag tag) {
+    switch (tag) {
+    case MemoryTag::Mesh:
+        return "mesh";
+    case MemoryTag::Render:
+        return "render";
+    case MemoryTag::Editor:
+        return "editor";
+    case MemoryTag::Grid:
+        return "grid";
+    case MemoryTag::Physics:
+        return "physics";
+    default:
+        return "other";
+    }
+}
+
+MemoryStats memory_stats(MemoryTag tag) {
+    const TagCounters &c = counters[(int)tag];
+    return {.bytes = c.bytes.load(),
+            .peak_bytes = c.peak_bytes.load(),
+            .allocations = c.allocations.load(),
+            .gpu_bytes = c.gpu_bytes.load(),
+            .gpu_peak_bytes = c.gpu_peak_bytes.load()};
+}
+
+MemoryScope::MemoryScope(MemoryTag tag) : previous(current_tag) { current_tag = tag; }
+
+MemoryScope::~MemoryScope() { current_tag = previous; }
+
+MemoryTag current_memory_tag() { return current_tag; }
+
+void track_gpu_memory(MemoryTag tag, int64_t bytes) {
+    TagCounters &c = counters[(int)tag];
+    add_to_peak(c.gpu_bytes, c.gpu_peak_bytes, bytes);
+}
+
+std::string kib(int64_t bytes) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1f KiB", bytes / 1024.0);
+    return text;
+}
+
+std::string memory_report() {
+    std::string report;
+    for (int i = 0; i < (int)MemoryTag::Count; ++i) {
+        MemoryStats stats = memory_stats((MemoryTag)i);
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-8s heap %12s (peak %12s) in %7lld blocks, gpu %12s\n",
+                      name((MemoryTag)i), kib(stats.bytes).c_str(), kib(stats.peak_bytes).c_str(),
+                      (long long)stats.allocations, kib(stats.gpu_bytes).c_str());
+        report += line;
+    }
+    return report;
+}
+
+void write_memory_report(const std::string &path) {
+    std::ofstream file(path);
+    if (!file) {
+        log("could not write " + path);
+        return;
+    }
+    file << "{\n";
+    for (int i = 0; i < (int)MemoryTag::Count; ++i) {
+        MemoryStats stats = memory_stats((MemoryTag)i);
+        file << "  \"" << name((MemoryTag)i) << "\": {";
+        file << "\"bytes\": " << stats.bytes << ", ";
+        file << "\"peak_bytes\": " << stats.peak_bytes << ", ";
+        file << "\"allocations\": " << stats.allocations << ", ";
+        file << "\"gpu_bytes\": " << stats.gpu_bytes << ", ";
+        file << "\"gpu_peak_bytes\": " << stats.gpu_peak_bytes << "}";
+        file << (i + 1 < (int)MemoryTag::Count ? ",\n" : "\n");
+    }
+    file << "}\n";
+    if (!file) {
+        log("could not write " + path);
+    }
+}
+
+Arena make_arena(size_t capacity) {
+    Arena arena;
+    arena.data = static_cast<char *>(std::malloc(capacity));
+    arena.capacity = capacity;
+    return arena;
+}
+
+void free_arena(Arena &arena) {
+    std::free(arena.data);
+    arena = Arena{};
+}
+
+void *allocate(Arena &arena, size_t size, size_t alignment) {
+    size_t start = (arena.used + alignment - 1) & ~(alignment - 1);
+    if (start + size > arena.capacity) {
+        throw std::runtime_error("Arena is full: " + std::to_string(start + size) + " of " +
+                                 std::to_string(arena.capacity) + " bytes");
+    }
+    arena.used = start + size;
+    arena.peak = std::max(arena.peak, arena.used);
+    return arena.data + start;
+}
+
+void reset(Arena &arena) { arena.used = 0; }
+
+// The free list is stored in the free blocks themselves
+void free_block(Pool &pool, void *block) {
+    *static_cast<void **>(block) = pool.free_list;
+    pool.free_list = block;
+}
+
+Arena &frame_arena() {
+    static Arena arena = make_arena(4 << 20);
+    return arena;
+}
+
+void *allocate(Pool &pool) {
+    std::lock_guard lock(pool.mutex);
+    if (!pool.free_list) {
+        // Accounted to whoever needed the chunk
+        char *chunk = static_cast<char *>(::operator new(pool.block_size * pool.blocks_per_chunk));
+        pool.chunks.push_back(chunk);
+        for (size_t i = 0; i < pool.blocks_per_chunk; ++i) {
+            free_block(pool, chunk + i * pool.block_size);
+        }
+    }
+    void *block = pool.free_list;
+    pool.free_list = *static_cast<void **>(block);
+    return block;
+}
+
+void free(Pool &pool, void *block) {
+    std::lock_guard lock(pool.mutex);
+    free_block(pool, block);
+}
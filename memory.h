@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Number of calls to the global operator new since the start. The difference over a frame is the
+// number of heap allocations done by that frame, which should be 0 once the level is loaded.
+uint64_t allocation_count();
+
+// Subsystems that heap and GPU memory are accounted to. Allocations go to the tag of the
+// innermost MemoryScope of the thread that makes them, Other when there is none.
+enum class MemoryTag { Other, Mesh, Render, Editor, Grid, Physics, Count };
+
+const char *name(MemoryTag tag);
+
+struct MemoryStats {
+    int64_t bytes;
+    int64_t peak_bytes;
+    int64_t allocations; // live ones
+    int64_t gpu_bytes;
+    int64_t gpu_peak_bytes;
+};
+
+MemoryStats memory_stats(MemoryTag tag);
+
+struct MemoryScope {
+    explicit MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+    MemoryTag previous;
+};
+
+MemoryTag current_memory_tag();
+
+// Buffers uploaded (positive) or deleted (negative), the driver does not tell us.
+void track_gpu_memory(MemoryTag tag, int64_t bytes);
+
+// One line per tag
+std::string memory_report();
+// Logs instead of throwing when the file cannot be written
+void write_memory_report(const std::string &path);
+
+// For containers that always belong to the same subsystem, whoever grows them.
+template <typename T, MemoryTag Tag> struct TaggedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind {
+        using other = TaggedAllocator<U, Tag>;
+    };
+
+    TaggedAllocator() = default;
+    template <typename U> TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+    T *allocate(size_t n) {
+        MemoryScope scope(Tag);
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t) { ::operator delete(p); }
+
+    template <typename U> bool operator==(const TaggedAllocator<U, Tag> &) const { return true; }
+};
+
+// Linear allocator: an allocation moves a pointer forward in one block, reset frees everything at
+// once. Destructors are not called.
+struct Arena {
+    char *data = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t peak = 0; // highest use since the arena was made, to size it
+};
+
+Arena make_arena(size_t capacity);
+void free_arena(Arena &arena);
+void *allocate(Arena &arena, size_t size, size_t alignment = alignof(std::max_align_t));
+void reset(Arena &arena);
+
+template <typename T> T *allocate_array(Arena &arena, size_t n) {
+    return static_cast<T *>(allocate(arena, n * sizeof(T), alignof(T)));
+}
+
+// Transient data of the frame being computed, it is reset at the end of each iteration of the
+// main loop so nothing allocated from it can be kept to the next frame.
+Arena &frame_arena();
+
+// To put standard containers in an arena. Freeing does nothing, a vector that grows leaves its
+// previous storage behind until the reset.
+template <typename T> struct ArenaAllocator {
+    using value_type = T;
+
+    Arena *arena;
+
+    explicit ArenaAllocator(Arena &arena) : arena(&arena) {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n) { return allocate_array<T>(*arena, n); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+        return arena == other.arena;
+    }
+};
+
+template <typename T> using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename T> FrameVector<T> make_frame_vector(size_t capacity = 0) {
+    FrameVector<T> vector{ArenaAllocator<T>(frame_arena())};
+    vector.reserve(capacity);
+    return vector;
+}
+
+// Free list of blocks of one size, carved from chunks that are kept until the end. For small
+// objects that live long but come and go one at a time, like the blocks of the grid.
+struct Pool {
+    size_t block_size;
+    size_t blocks_per_chunk;
+    void *free_list = nullptr;
+    std::vector<char *> chunks;
+    std::mutex mutex; // levels can be built on another thread than the one drawing
+};
+
+void *allocate(Pool &pool);
+void free(Pool &pool, void *block);
+
+// One pool per block size and alignment, shared by all the types that fit.
+template <size_t Size, size_t Alignment> Pool &pool_for() {
+    // Free blocks hold the pointer to the next one
+    constexpr size_t alignment = std::max(Alignment, alignof(void *));
+    constexpr size_t block_size = (std::max(Size, sizeof(void *)) + alignment - 1) / alignment *
+                                  alignment;
+    static Pool pool{.block_size = block_size, .blocks_per_chunk = 256};
+    return pool;
+}
+
+// Single objects come from the pool of their size, arrays (the buckets of a hash map) from the
+// heap. Meant for node based containers.
+template <typename T> struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U> PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        if (n == 1) {
+            return static_cast<T *>(::allocate(pool_for<sizeof(T), alignof(T)>()));
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (n == 1) {
+            ::free(pool_for<sizeof(T), alignof(T)>(), p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U> bool operator==(const PoolAllocator<U> &) const { return true; }
+};
@@ -21,24 +21,17 @@ std::vector<Vec3> compute_normals(const std::vector<Vec3> &vertices) {
 }
 
 Mesh floor_mesh(int rows, int cols) {
+    // The floor is flat, one quad covers the whole (rows - 1) x (cols - 1) area
     Mesh mesh;
     Vec3 translation = {-50, 0, 50};
-    for (int i = 0; i < rows - 1; ++i) {
-        for (int j = 0; j < cols - 1; ++j) {
-            float ii = i;
-            float jj = j;
-            Vec3 v0 = {ii, 0.f, -jj};
-            Vec3 v1 = {ii + 1, 0.f, -jj};
-            Vec3 v2 = {ii + 1, 0.f, -(jj + 1)};
-            Vec3 v3 = {ii, 0.f, -(jj + 1)};
-            mesh.vertices.push_back(v0 + translation);
-            mesh.vertices.push_back(v1 + translation);
-            mesh.vertices.push_back(v3 + translation);
-            mesh.vertices.push_back(v3 + translation);
-            mesh.vertices.push_back(v1 + translation);
-            mesh.vertices.push_back(v2 + translation);
-        }
-    }
+    float width = rows - 1;
+    float depth = cols - 1;
+    Vec3 v0 = {0.f, 0.f, 0.f};
+    Vec3 v1 = {width, 0.f, 0.f};
+    Vec3 v2 = {width, 0.f, -depth};
+    Vec3 v3 = {0.f, 0.f, -depth};
+    mesh.vertices = {v0 + translation, v1 + translation, v3 + translation,
+                     v3 + translation, v1 + translation, v2 + translation};
 
     mesh.normals = compute_normals(mesh.vertices);
 
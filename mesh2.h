@@ -7,6 +7,9 @@ struct Mesh {
     std::vector<Vec3> normals;
 };
 
+Vec3 normal_for_face(Vec3 a, Vec3 b, Vec3 c);
+std::vector<Vec3> compute_normals(const std::vector<Vec3> &vertices);
+
 Mesh floor_mesh(int rows, int cols);
 Mesh rectangle_mesh(float width, float height, float depth);
 Mesh floor_tile_mesh(float width, float depth);
@@ -0,0 +1,274 @@
+#include "overlay.h"
+
+#include "maths.h"
+#include "memory.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdio>
+
+struct Glyph {
+    char c;
+    unsigned char rows[7]; // 5 bits per row, the leftmost pixel is the highest bit
+};
+
+// clang-format off
+constexpr Glyph font[] = {
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {'A', {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11}},
+    {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+    {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+    {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+    {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {',', {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+    {'+', {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}},
+    {'=', {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}},
+    {'_', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+    {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+    {'>', {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}},
+    {'?', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}},
+};
+// clang-format on
+
+constexpr int n_glyphs = sizeof(font) / sizeof(font[0]);
+// Glyphs are laid out in a row of cells with a pixel of padding, the last cell is solid for the
+// graph and the background.
+constexpr int cell_width = 6;
+constexpr int cell_height = 8;
+constexpr int solid_cell = n_glyphs;
+constexpr int glyph_scale = 2;
+constexpr int floats_per_overlay_vertex = 8;
+
+int glyph_index(char c) {
+    static int table[128] = {};
+    static bool built = false;
+    if (!built) {
+        std::fill(std::begin(table), std::end(table), n_glyphs - 1); // '?'
+        for (int i = 0; i < n_glyphs; ++i) {
+            table[(int)font[i].c] = i;
+            if (font[i].c >= 'A' && font[i].c <= 'Z') {
+                table[font[i].c - 'A' + 'a'] = i;
+            }
+        }
+        built = true;
+    }
+    return (c >= 0 && c < 128) ? table[(int)c] : n_glyphs - 1;
+}
+
+Overlay make_overlay() {
+    MemoryScope scope(MemoryTag::Render);
+    Overlay overlay;
+    overlay.shader = compile("shaders/overlay_vertex.glsl", "shaders/overlay_fragment.glsl");
+
+    overlay.atlas_width = (n_glyphs + 1) * cell_width;
+    std::vector<unsigned char> pixels(overlay.atlas_width * cell_height, 0);
+    for (int g = 0; g < n_glyphs; ++g) {
+        for (int y = 0; y < 7; ++y) {
+            for (int x = 0; x < 5; ++x) {
+                if (font[g].rows[y] & (0x10 >> x)) {
+                    pixels[y * overlay.atlas_width + g * cell_width + x] = 255;
+                }
+            }
+        }
+    }
+    for (int y = 0; y < cell_height; ++y) {
+        for (int x = 0; x < cell_width; ++x) {
+            pixels[y * overlay.atlas_width + solid_cell * cell_width + x] = 255;
+        }
+    }
+
+    glGenTextures(1, &overlay.atlas);
+    glBindTexture(GL_TEXTURE_2D, overlay.atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, overlay.atlas_width, cell_height, 0, GL_RED,
+                 GL_UNSIGNED_BYTE, pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    track_gpu_memory(MemoryTag::Render, pixels.size());
+
+    // The attributes point to the stream buffer, at a different offset each frame
+    glGenVertexArrays(1, &overlay.VAO);
+    glBindVertexArray(overlay.VAO);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    return overlay;
+}
+
+void free_overlay(Overlay &overlay) {
+    track_gpu_memory(MemoryTag::Render, -(int64_t)overlay.atlas_width * cell_height);
+    glDeleteTextures(1, &overlay.atlas);
+    glDeleteVertexArrays(1, &overlay.VAO);
+    overlay = Overlay{};
+}
+
+void add_frame_time(Overlay &overlay, float ms) {
+    overlay.frame_times[overlay.next_frame] = ms;
+    overlay.next_frame = (overlay.next_frame + 1) % overlay_history;
+}
+
+struct OverlayBatch {
+    FrameVector<float> vertices;
+    float atlas_width;
+};
+
+void quad(OverlayBatch &batch, float x0, float y0, float x1, float y1, int cell, Vec4 color) {
+    // Solid quads sample the middle of the solid cell, glyphs the whole 5x7 glyph
+    float u0 = cell * cell_width / batch.atlas_width;
+    float u1 = (cell * cell_width + 5) / batch.atlas_width;
+    float v0 = 0;
+    float v1 = 7.f / cell_height;
+    if (cell == solid_cell) {
+        u0 = u1 = (cell * cell_width + 2.5f) / batch.atlas_width;
+        v0 = v1 = 0.5f;
+    }
+    float corners[6][4] = {{x0, y0, u0, v0}, {x1, y0, u1, v0}, {x0, y1, u0, v1},
+                           {x0, y1, u0, v1}, {x1, y0, u1, v0}, {x1, y1, u1, v1}};
+    for (auto &corner : corners) {
+        batch.vertices.insert(batch.vertices.end(), corner, corner + 4);
+        batch.vertices.insert(batch.vertices.end(), {color.x, color.y, color.z, color.w});
+    }
+}
+
+constexpr float line_height = (cell_height + 2) * glyph_scale;
+
+void text(OverlayBatch &batch, float x, float &y, const char *line, Vec4 color) {
+    for (const char *c = line; *c; ++c, x += cell_width * glyph_scale) {
+        if (*c != ' ') {
+            quad(batch, x, y, x + 5 * glyph_scale, y + 7 * glyph_scale, glyph_index(*c), color);
+        }
+    }
+    y += line_height;
+}
+
+void graph(OverlayBatch &batch, const Overlay &overlay, float x, float &y) {
+    constexpr float height = 60;
+    constexpr float ms_scale = height / 33.3f; // two frames at 60 Hz fill the graph
+    Vec4 background = {0.f, 0.f, 0.f, 0.5f};
+    quad(batch, x, y, x + overlay_history * 2, y + height, solid_cell, background);
+    for (int i = 0; i < overlay_history; ++i) {
+        float ms = overlay.frame_times[(overlay.next_frame + i) % overlay_history];
+        float bar = std::min(height, ms * ms_scale);
+        Vec4 color = ms > 16.7f ? Vec4{0.9f, 0.2f, 0.2f, 1.f} : Vec4{0.2f, 0.9f, 0.2f, 1.f};
+        quad(batch, x + i * 2, y + height - bar, x + i * 2 + 1, y + height, solid_cell, color);
+    }
+    float budget = y + height - 16.7f * ms_scale;
+    quad(batch, x, budget, x + overlay_history * 2, budget + 1, solid_cell, {1.f, 1.f, 1.f, 0.5f});
+    y += height + line_height / 2;
+}
+
+void draw(Overlay &overlay, StreamBuffer &stream, const OverlayStats &stats, int width,
+          int height) {
+    OverlayBatch batch = {.vertices = make_frame_vector<float>(4096),
+                          .atlas_width = (float)overlay.atlas_width};
+    Vec4 white = {1.f, 1.f, 1.f, 1.f};
+    Vec4 grey = {0.7f, 0.7f, 0.7f, 1.f};
+    char line[128];
+    float x = 10;
+    float y = 10;
+
+    graph(batch, overlay, x, y);
+
+    std::snprintf(line, sizeof(line), "FPS %.0f  CPU %.2f MS", stats.fps, stats.cpu_ms);
+    text(batch, x, y, line, white);
+    std::snprintf(line, sizeof(line), "DRAWS %d  TRIS %d  UNIFORMS %d  BLOCKS %d",
+                  stats.render.draw_calls, stats.render.triangles, stats.render.uniform_uploads,
+                  stats.render.grid_blocks);
+    text(batch, x, y, line, white);
+    std::snprintf(line, sizeof(line), "STATE CHANGES %d  AVOIDED %d", stats.render.state_changes,
+                  stats.render.state_changes_avoided);
+    text(batch, x, y, line, white);
+    std::snprintf(line, sizeof(line), "STREAM %.1f KB  WAITS %d",
+                  stats.render.stream_bytes / 1024.0, stats.render.stream_waits);
+    text(batch, x, y, line, white);
+    std::snprintf(line, sizeof(line), "LIGHTS %d  IN CLUSTERS %d", stats.render.lights,
+                  stats.render.light_indices);
+    text(batch, x, y, line, white);
+    std::snprintf(line, sizeof(line), "HEAP %.2f MB  GPU %.2f MB  ALLOCS %llu",
+                  stats.heap_bytes / 1048576.0, stats.gpu_bytes / 1048576.0,
+                  (unsigned long long)stats.allocations);
+    text(batch, x, y, line, white);
+
+    if (stats.gpu_timer) {
+        for (int i = 0; i < stats.gpu_timer->n_results; ++i) {
+            const GpuPassTime &pass = stats.gpu_timer->results[i];
+            std::snprintf(line, sizeof(line), "%*sGPU %s %.2f MS", pass.depth * 2, "", pass.name,
+                          pass.ms);
+            text(batch, x, y, line, grey);
+        }
+    }
+
+    int n_vertices = batch.vertices.size() / floats_per_overlay_vertex;
+    long size = batch.vertices.size() * sizeof(float);
+    StreamAllocation allocation = upload(stream, batch.vertices.data(), size);
+    if (!allocation.data) {
+        return;
+    }
+
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+
+    UseShader use(overlay.shader.program);
+    glBindVertexArray(overlay.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    int stride = floats_per_overlay_vertex * sizeof(float);
+    auto *base = (char *)allocation.offset;
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, base);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, base + 2 * sizeof(float));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, base + 4 * sizeof(float));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, overlay.atlas);
+    set_int(overlay.shader, "atlas", 0);
+    set_vec2(overlay.shader, "screen_size", width, height);
+    glDrawArrays(GL_TRIANGLES, 0, n_vertices);
+    render_stats().draw_calls++;
+    render_stats().triangles += n_vertices / 3;
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (depth_test) {
+        glEnable(GL_DEPTH_TEST);
+    }
+}
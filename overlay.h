@@ -0,0 +1,41 @@
+#pragma once
+
+#include "gpu_timer.h"
+#include "render_stats.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+#include <cstdint>
+
+// Debug overlay with the frame time graph and the counters of the last frame. Text uses a 5x7
+// bitmap font baked in a texture at startup, the text and the graph are written to the stream
+// buffer each frame and drawn with one call.
+
+constexpr int overlay_history = 120;
+
+struct OverlayStats {
+    float fps;
+    float cpu_ms;
+    uint64_t allocations;
+    RenderStats render;
+    int64_t heap_bytes;
+    int64_t gpu_bytes;
+    const GpuTimer *gpu_timer;
+};
+
+struct Overlay {
+    unsigned int VAO{};
+    unsigned int atlas{};
+    int atlas_width{};
+    Shader shader;
+    float frame_times[overlay_history]{}; // ms, oldest at next_frame
+    int next_frame = 0;
+};
+
+Overlay make_overlay();
+void free_overlay(Overlay &overlay);
+
+void add_frame_time(Overlay &overlay, float ms);
+
+void draw(Overlay &overlay, StreamBuffer &stream, const OverlayStats &stats, int width,
+          int height);
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "memory.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline int worker_count() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+// Calls f(i) for every i in [begin, end), split in one contiguous range per core. Iterations must
+// only write to their own slot of preallocated storage. Small ranges stay on the calling thread,
+// starting threads costs more than the work.
+template <typename F> void parallel_for(int begin, int end, F f, int min_per_thread = 64) {
+    int n = end - begin;
+    int threads = std::min(worker_count(), n / std::max(1, min_per_thread));
+    if (threads <= 1) {
+        for (int i = begin; i < end; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    // Workers account their allocations like the caller
+    MemoryTag tag = current_memory_tag();
+    auto run = [&](int t) {
+        MemoryScope scope(tag);
+        int from = begin + (long)n * t / threads;
+        int to = begin + (long)n * (t + 1) / threads;
+        for (int i = from; i < to; ++i) {
+            f(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(run, t);
+    }
+    run(0);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+// Threads started once for the loops run every frame, where starting threads would cost more than
+// the work and allocate. The loop is passed as a function and a pointer to it, so that running one
+// does not allocate either. One loop at a time, from one thread.
+struct WorkerPool {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    bool stopping = false;
+    // The current loop, split in parts ranges, the first one runs on the calling thread
+    void (*body)(void *context, int from, int to) = nullptr;
+    void *context = nullptr;
+    int begin = 0;
+    int n = 0;
+    int parts = 0;
+    int pending = 0;
+    MemoryTag tag = MemoryTag::Other;
+
+    WorkerPool() {
+        for (int t = 1; t < worker_count(); ++t) {
+            threads.emplace_back([this, t] { work(t); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    void run(int part) {
+        MemoryScope scope(tag);
+        body(context, begin + (long)n * part / parts, begin + (long)n * (part + 1) / parts);
+    }
+
+    void work(int t) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                if (t >= parts) {
+                    continue;
+                }
+            }
+            run(t);
+            std::lock_guard lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+// Same as parallel_for on the threads of the pool.
+template <typename F>
+void parallel_for(WorkerPool &pool, int begin, int end, F f, int min_per_thread = 64) {
+    int n = end - begin;
+    int parts = std::min((int)pool.threads.size() + 1, n / std::max(1, min_per_thread));
+    if (parts <= 1) {
+        for (int i = begin; i < end; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock(pool.mutex);
+        pool.body = [](void *context, int from, int to) {
+            F &f = *static_cast<F *>(context);
+            for (int i = from; i < to; ++i) {
+                f(i);
+            }
+        };
+        pool.context = &f;
+        pool.begin = begin;
+        pool.n = n;
+        pool.parts = parts;
+        pool.pending = parts - 1;
+        pool.tag = current_memory_tag();
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    pool.run(0);
+    std::unique_lock lock(pool.mutex);
+    pool.done.wait(lock, [&] { return pool.pending == 0; });
+}
@@ -2,92 +2,234 @@
 
 #include "logging.h"
 #include "maths.h"
+#include "mesh2.h"
 
-//IntersectData intersect_tetras_point(Sphere sphere) {
-//    IntersectData d;
-//    for (TetraOcta &obj : world.tetraoctas) {
-//
-//        // FIXME: no need to use duplicated vertices
-//        if (norm(sphere.pos - centroid(obj.mesh.vertices)) - sphere.radius >
-//            obj.circumsphere_radius) {
-//            continue;
-//        }
-//
-//        int n_faces = obj.mesh.normals.size() / 3;
-//        for (int i = 0; i < n_faces; ++i) {
-//            Vec3 normal = obj.mesh.normals[i * 3];
-//            Vec3 reference = obj.mesh.vertices[i * 3];
-//            float distance = dot(normal, sphere.pos - reference);
-//            if (distance > 0 && distance < sphere.radius) {
-//                d.intersected = true;
-//                // FIXME: need better way to handle collisions with multiple objects
-//                d.normal = normalize(d.normal + normal);
-//            }
-//        }
-//    }
-//    return d;
-//}
-
-// IntersectData intersect(const Rectangle &r, const Sphere &sphere) {
-//     IntersectData d;
-//     Vec3 pos = r.obj.transform * r.center;
-//
-//     if (norm(sphere.pos - pos) - sphere.radius >
-//         norm({r.width / 2.f, r.height / 2.f, r.depth / 2.f})) {
-//         return d;
-//     }
-//
-//     float distances[] = {
-//         pos.x - r.width / 2.f - sphere.pos.x,    // left
-//         sphere.pos.x - (pos.x + r.width / 2.f),  // right
-//         sphere.pos.y - (pos.y + r.height / 2.f), // top
-//         pos.y - r.height / 2.f - sphere.pos.y,   // bottom
-//         sphere.pos.z - (pos.z + r.depth / 2.f),  // front
-//         pos.z - r.depth / 2.f - sphere.pos.z,    // back
-//     };
-//     int index_smallest_distance = -1;
-//     bool intersected = false;
-//     for (int i = 0; i < 6; ++i) {
-//         if (distances[i] >= 0 && distances[i] < sphere.radius) {
-//             if (index_smallest_distance == -1 ||
-//                 distances[i] < distances[index_smallest_distance]) {
-//                 index_smallest_distance = i;
-//             }
-//             intersected = true;
-//         }
-//     }
-//     Vec3 normals[] = {{-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
-//     if (intersected) {
-//         d.intersected = true;
-//         d.normal = normals[index_smallest_distance];
-//     }
-//     return d;
-// }
-
-
-//void walk_on_surface() {
-//    const Entity &entity = world.entities[entity_index];
-//    for (int face_index = 0; face_index < entity.mesh.vertices.size() / 3; ++face_index) {
-//        Vec3 v0 = entity.transform * entity.mesh.vertices[face_index * 3];
-//        Vec3 v1 = entity.transform * entity.mesh.vertices[face_index * 3 + 1];
-//        Vec3 v2 = entity.transform * entity.mesh.vertices[face_index * 3 + 2];
-//        Vec3 n = entity.mesh.normals[face_index * 3];
-//
-//        Vec3 face_center = centroid(v0, v1, v2);
-//        float circumsphere_radius = norm(v0 - face_center);
-//        if (norm(sphere.pos - face_center) < circumsphere_radius) {
-//
-//            Vec3 p0 = sphere.pos - v0;
-//            Vec3 p1 = sphere.pos - v1;
-//            Vec3 p2 = sphere.pos - v2;
-//            if (dot(p0, v1 - v0) > 0 && dot(p1, v2 - v1) > 0 && dot(p2, v0 - v2) > 0) {
-//                float distance = dot(sphere.pos - v0, n);
-//                if (distance - sphere.radius < 0) {
-//                    log(distance - sphere.radius);
-//                    velocity -= n * (distance - sphere.radius);
-//                    break;
-//                }
-//            }
-//        }
-//    }
-//}
\ No newline at end of file
+#include <algorithm>
+#include <cmath>
+
+// Distance kept between the sphere and what it touches, so that the next sweep does not start
+// inside the triangle.
+constexpr float skin = 0.001f;
+constexpr int max_slides = 4;
+
+uint64_t bucket_key(int x, int z) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z; }
+
+void clear(CollisionWorld &world) {
+    clear(world.triangles);
+    world.cells.clear();
+}
+
+void add_triangle(CollisionWorld &world, Vec3 a, Vec3 b, Vec3 c) {
+    int index = size(world.triangles);
+    add_triangle(world.triangles, a, b, c, index);
+
+    int x0 = std::floor(std::min({a.x, b.x, c.x}) / world.cell_size);
+    int x1 = std::floor(std::max({a.x, b.x, c.x}) / world.cell_size);
+    int z0 = std::floor(std::min({a.z, b.z, c.z}) / world.cell_size);
+    int z1 = std::floor(std::max({a.z, b.z, c.z}) / world.cell_size);
+    for (int x = x0; x <= x1; ++x) {
+        for (int z = z0; z <= z1; ++z) {
+            world.cells[bucket_key(x, z)].push_back(index);
+        }
+    }
+}
+
+void query(const CollisionWorld &world, Vec3 min, Vec3 max, std::vector<int> &triangles) {
+    triangles.clear();
+    int x0 = std::floor(min.x / world.cell_size);
+    int x1 = std::floor(max.x / world.cell_size);
+    int z0 = std::floor(min.z / world.cell_size);
+    int z1 = std::floor(max.z / world.cell_size);
+    for (int x = x0; x <= x1; ++x) {
+        for (int z = z0; z <= z1; ++z) {
+            auto it = world.cells.find(bucket_key(x, z));
+            if (it != world.cells.end()) {
+                triangles.insert(triangles.end(), it->second.begin(), it->second.end());
+            }
+        }
+    }
+    // a triangle over several buckets is found several times
+    std::sort(triangles.begin(), triangles.end());
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+}
+
+// Time of first contact: smallest root of a t^2 + b t + c in [0, max_root]
+bool lowest_root(float a, float b, float c, float max_root, float &root) {
+    float determinant = b * b - 4 * a * c;
+    if (determinant < 0 || a == 0) {
+        return false;
+    }
+    float sqrt_d = std::sqrt(determinant);
+    float r1 = (-b - sqrt_d) / (2 * a);
+    float r2 = (-b + sqrt_d) / (2 * a);
+    if (r1 > r2) {
+        std::swap(r1, r2);
+    }
+    // r1 < 0 < r2 means the sphere already overlaps and is leaving
+    if (r1 >= 0 && r1 < max_root) {
+        root = r1;
+        return true;
+    }
+    return false;
+}
+
+bool inside_triangle(Vec3 p, Vec3 a, Vec3 b, Vec3 c, Vec3 n) {
+    return dot(n, cross(b - a, p - a)) >= 0 && dot(n, cross(c - b, p - b)) >= 0 &&
+           dot(n, cross(a - c, p - c)) >= 0;
+}
+
+// Based on Kasper Fauerby, "Improved Collision detection and Response": first against the plane
+// of the triangle, then against its vertices and edges if the sphere touches the plane outside.
+IntersectData sweep_sphere(const Sphere &sphere, Vec3 velocity, Vec3 a, Vec3 b, Vec3 c) {
+    IntersectData d;
+    Vec3 n = normal_for_face(a, b, c);
+    float n_dot_v = dot(n, velocity);
+    if (n_dot_v >= 0) {
+        // moving away from the triangle or along it
+        return d;
+    }
+
+    float distance = dot(n, sphere.pos - a);
+    if (distance < -sphere.radius) {
+        // behind the triangle
+        return d;
+    }
+
+    // When the sphere starts touching the plane, 0 if it already does
+    float t_plane = 0;
+    if (distance > sphere.radius) {
+        t_plane = (distance - sphere.radius) / -n_dot_v;
+    }
+    if (t_plane > 1) {
+        return d;
+    }
+
+    Vec3 plane_point = sphere.pos + velocity * t_plane - n * std::min(distance, sphere.radius);
+    if (inside_triangle(plane_point, a, b, c, n)) {
+        d.intersected = true;
+        d.t = t_plane;
+        d.point = plane_point;
+        d.normal = n;
+        return d;
+    }
+
+    float t = 1;
+    float r2 = sphere.radius * sphere.radius;
+    float v2 = dot(velocity, velocity);
+    for (Vec3 p : {a, b, c}) {
+        float root;
+        Vec3 to_center = sphere.pos - p;
+        if (lowest_root(v2, 2 * dot(velocity, to_center), dot(to_center, to_center) - r2, t,
+                        root)) {
+            t = root;
+            d.intersected = true;
+            d.point = p;
+        }
+    }
+
+    Vec3 edges[3][2] = {{a, b}, {b, c}, {c, a}};
+    for (auto &edge : edges) {
+        Vec3 e = edge[1] - edge[0];
+        Vec3 base_to_center = edge[0] - sphere.pos;
+        float e2 = dot(e, e);
+        float e_dot_v = dot(e, velocity);
+        float e_dot_b = dot(e, base_to_center);
+        float qa = e2 * -v2 + e_dot_v * e_dot_v;
+        float qb = e2 * (2 * dot(velocity, base_to_center)) - 2 * e_dot_v * e_dot_b;
+        float qc = e2 * (r2 - dot(base_to_center, base_to_center)) + e_dot_b * e_dot_b;
+        float root;
+        if (lowest_root(qa, qb, qc, t, root)) {
+            float f = (e_dot_v * root - e_dot_b) / e2;
+            if (f >= 0 && f <= 1) {
+                t = root;
+                d.intersected = true;
+                d.point = edge[0] + e * f;
+            }
+        }
+    }
+
+    if (d.intersected) {
+        d.t = t;
+        d.normal = normalize(sphere.pos + velocity * t - d.point);
+    }
+    return d;
+}
+
+Vec3 triangle_vertex(const TriangleSoA &t, int i, int k) {
+    Vec3 v0 = {t.v0x[i], t.v0y[i], t.v0z[i]};
+    if (k == 1) {
+        return v0 + Vec3{t.e1x[i], t.e1y[i], t.e1z[i]};
+    }
+    if (k == 2) {
+        return v0 + Vec3{t.e2x[i], t.e2y[i], t.e2z[i]};
+    }
+    return v0;
+}
+
+IntersectData sweep_sphere(const CollisionWorld &world, const Sphere &sphere, Vec3 velocity) {
+    Vec3 end = sphere.pos + velocity;
+    Vec3 extent = {sphere.radius, sphere.radius, sphere.radius};
+    Vec3 min = Vec3{std::min(sphere.pos.x, end.x), std::min(sphere.pos.y, end.y),
+                    std::min(sphere.pos.z, end.z)} -
+               extent;
+    Vec3 max = Vec3{std::max(sphere.pos.x, end.x), std::max(sphere.pos.y, end.y),
+                    std::max(sphere.pos.z, end.z)} +
+               extent;
+
+    static thread_local std::vector<int> candidates;
+    query(world, min, max, candidates);
+
+    IntersectData nearest;
+    for (int i : candidates) {
+        IntersectData d = sweep_sphere(sphere, velocity, triangle_vertex(world.triangles, i, 0),
+                                       triangle_vertex(world.triangles, i, 1),
+                                       triangle_vertex(world.triangles, i, 2));
+        if (d.intersected && (!nearest.intersected || d.t < nearest.t)) {
+            nearest = d;
+        }
+    }
+    return nearest;
+}
+
+Vec3 slide(const CollisionWorld &world, Sphere sphere, Vec3 velocity) {
+    for (int i = 0; i < max_slides && norm(velocity) > skin; ++i) {
+        IntersectData d = sweep_sphere(world, sphere, velocity);
+        if (!d.intersected) {
+            sphere.pos += velocity;
+            break;
+        }
+        sphere.pos += velocity * d.t + d.normal * skin;
+        // the rest of the movement continues along the surface
+        Vec3 remaining = velocity * (1 - d.t);
+        velocity = remaining - d.normal * dot(remaining, d.normal);
+    }
+    return sphere.pos;
+}
+
+Vec3 move_character(const CollisionWorld &world, const Heightfield &ground, Sphere sphere,
+                    Vec3 velocity, float step_height) {
+    Vec3 horizontal = {velocity.x, 0.f, velocity.z};
+    float radius = sphere.radius;
+    auto ground_under = [&](Vec3 from, Vec3 to) {
+        return highest_ground(ground, std::min(from.x, to.x) - radius,
+                              std::max(from.x, to.x) + radius, std::min(from.z, to.z) - radius,
+                              std::max(from.z, to.z) + radius, sphere.pos.y - radius + step_height);
+    };
+
+    // Up on what is ahead first, the walk then goes over its side
+    float ahead = ground_under(sphere.pos, sphere.pos + horizontal);
+    if (ahead > sphere.pos.y - radius) {
+        sphere.pos.y = ahead + radius + skin;
+    }
+    sphere.pos = slide(world, sphere, horizontal);
+
+    // Only going up collides, the ground stops the fall
+    float below = ground_under(sphere.pos, sphere.pos);
+    if (velocity.y > 0) {
+        sphere.pos = slide(world, sphere, {0.f, velocity.y, 0.f});
+    } else {
+        sphere.pos.y += velocity.y;
+    }
+    sphere.pos.y = std::max(sphere.pos.y, below + radius);
+    return sphere.pos;
+}
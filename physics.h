@@ -1,6 +1,13 @@
 #pragma once
 
+#include "heightfield.h"
 #include "maths.h"
+#include "memory.h"
+#include "raycast.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 struct Sphere {
     Vec3 pos;
@@ -10,6 +17,41 @@ struct Sphere {
 struct IntersectData {
     bool intersected = false;
     Vec3 normal;
+    Vec3 point; // contact point on the triangle
+    float t = 1; // fraction of the movement done before the contact
 };
 
-//IntersectData intersect_tetras_point(Sphere sphere);
\ No newline at end of file
+template <typename T> using PhysicsAllocator = TaggedAllocator<T, MemoryTag::Physics>;
+using CollisionBucket = std::vector<int, PhysicsAllocator<int>>;
+
+// Triangles to collide against, bucketed in a uniform spatial hash on the xz plane. With a cell
+// size of 1 the buckets are the cells of the level grid, so a query only looks at the few cells
+// around the moving sphere whatever the size of the level.
+struct CollisionWorld {
+    float cell_size = 1;
+    TriangleSoA triangles;
+    std::unordered_map<uint64_t, CollisionBucket, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                       PhysicsAllocator<std::pair<const uint64_t, CollisionBucket>>>
+        cells;
+};
+
+void clear(CollisionWorld &world);
+void add_triangle(CollisionWorld &world, Vec3 a, Vec3 b, Vec3 c);
+
+// Triangles whose bucket overlaps the box, each one once.
+void query(const CollisionWorld &world, Vec3 min, Vec3 max, std::vector<int> &triangles);
+
+// Continuous collision of the sphere moving by velocity against one triangle, seen from its front.
+IntersectData sweep_sphere(const Sphere &sphere, Vec3 velocity, Vec3 a, Vec3 b, Vec3 c);
+
+// Earliest contact of the moving sphere with the world.
+IntersectData sweep_sphere(const CollisionWorld &world, const Sphere &sphere, Vec3 velocity);
+
+// Moves the sphere and slides it along what it hits. Returns the new center.
+Vec3 slide(const CollisionWorld &world, Sphere sphere, Vec3 velocity);
+
+// Same as slide for the horizontal movement, but the height comes from the ground under the
+// sphere: it climbs on ground up to step_height above its bottom, like a platform, and falls down
+// to the ground instead of colliding with it.
+Vec3 move_character(const CollisionWorld &world, const Heightfield &ground, Sphere sphere,
+                    Vec3 velocity, float step_height);
@@ -0,0 +1,444 @@
+#include "raycast.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAYCAST_X86
+#endif
+
+// https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
+// The SSE and AVX kernels are the same computation as intersect_one, on 4 or 8 lanes.
+
+constexpr float epsilon = 1e-7f;
+
+void clear(TriangleSoA &triangles) { triangles = TriangleSoA{}; }
+
+void resize(TriangleSoA &triangles, int n) {
+    for (auto *component : {&triangles.v0x, &triangles.v0y, &triangles.v0z, &triangles.e1x,
+                            &triangles.e1y, &triangles.e1z, &triangles.e2x, &triangles.e2y,
+                            &triangles.e2z}) {
+        component->resize(n);
+    }
+    triangles.id.resize(n);
+}
+
+void set_triangle(TriangleSoA &triangles, int i, Vec3 a, Vec3 b, Vec3 c, int id) {
+    Vec3 e1 = b - a;
+    Vec3 e2 = c - a;
+    triangles.v0x[i] = a.x;
+    triangles.v0y[i] = a.y;
+    triangles.v0z[i] = a.z;
+    triangles.e1x[i] = e1.x;
+    triangles.e1y[i] = e1.y;
+    triangles.e1z[i] = e1.z;
+    triangles.e2x[i] = e2.x;
+    triangles.e2y[i] = e2.y;
+    triangles.e2z[i] = e2.z;
+    triangles.id[i] = id;
+}
+
+void add_triangle(TriangleSoA &triangles, Vec3 a, Vec3 b, Vec3 c, int id) {
+    int i = size(triangles);
+    resize(triangles, i + 1);
+    set_triangle(triangles, i, a, b, c, id);
+}
+
+int size(const TriangleSoA &triangles) { return triangles.id.size(); }
+
+// Distance along the ray, or a negative value when there is no hit
+float intersect_one(const Ray &ray, const TriangleSoA &t, int i) {
+    Vec3 d = ray.direction;
+    Vec3 e1 = {t.e1x[i], t.e1y[i], t.e1z[i]};
+    Vec3 e2 = {t.e2x[i], t.e2y[i], t.e2z[i]};
+    Vec3 p = cross(d, e2);
+    float det = dot(e1, p);
+    if (det <= epsilon) {
+        // triangle is facing away from the ray, or parallel to it
+        return -1;
+    }
+    float inv_det = 1.f / det;
+    Vec3 s = ray.origin - Vec3{t.v0x[i], t.v0y[i], t.v0z[i]};
+    float u = dot(s, p) * inv_det;
+    if (u < 0 || u > 1) {
+        return -1;
+    }
+    Vec3 q = cross(s, e1);
+    float v = dot(d, q) * inv_det;
+    if (v < 0 || u + v > 1) {
+        return -1;
+    }
+    float distance = dot(e2, q) * inv_det;
+    return distance > epsilon ? distance : -1;
+}
+
+void keep_nearest(RayHit &hit, const TriangleSoA &triangles, int i, float t) {
+    if (t > 0 && t < hit.t) {
+        hit = {.t = t, .triangle = i, .id = triangles.id[i]};
+    }
+}
+
+RayHit intersect_scalar(const Ray &ray, const TriangleSoA &triangles, int begin, int end) {
+    RayHit hit;
+    for (int i = begin; i < end; ++i) {
+        keep_nearest(hit, triangles, i, intersect_one(ray, triangles, i));
+    }
+    return hit;
+}
+
+#ifdef RAYCAST_X86
+
+RayHit intersect_sse(const Ray &ray, const TriangleSoA &t, int begin, int end) {
+    RayHit hit;
+    __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y);
+    __m128 oz = _mm_set1_ps(ray.origin.z);
+    __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y);
+    __m128 dz = _mm_set1_ps(ray.direction.z);
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), eps = _mm_set1_ps(epsilon);
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 e1x = _mm_loadu_ps(&t.e1x[i]), e1y = _mm_loadu_ps(&t.e1y[i]);
+        __m128 e1z = _mm_loadu_ps(&t.e1z[i]);
+        __m128 e2x = _mm_loadu_ps(&t.e2x[i]), e2y = _mm_loadu_ps(&t.e2y[i]);
+        __m128 e2z = _mm_loadu_ps(&t.e2z[i]);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                                _mm_mul_ps(e1z, pz));
+        __m128 mask = _mm_cmpgt_ps(det, eps);
+        if (!_mm_movemask_ps(mask)) {
+            continue;
+        }
+        __m128 inv_det = _mm_div_ps(one, det);
+
+        __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(&t.v0x[i]));
+        __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(&t.v0y[i]));
+        __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(&t.v0z[i]));
+        __m128 u = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)),
+            inv_det);
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 v = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)),
+            inv_det);
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero),
+                                           _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+        __m128 distance = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+            inv_det);
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(distance, eps),
+                                           _mm_cmplt_ps(distance, _mm_set1_ps(hit.t))));
+
+        int lanes = _mm_movemask_ps(mask);
+        if (lanes) {
+            alignas(16) float distances[4];
+            _mm_store_ps(distances, distance);
+            for (int lane = 0; lane < 4; ++lane) {
+                if (lanes & (1 << lane)) {
+                    keep_nearest(hit, t, i + lane, distances[lane]);
+                }
+            }
+        }
+    }
+
+    RayHit tail = intersect_scalar(ray, t, i, end);
+    return tail.t < hit.t ? tail : hit;
+}
+
+__attribute__((target("avx"))) RayHit intersect_avx(const Ray &ray, const TriangleSoA &t,
+                                                   int begin, int end) {
+    RayHit hit;
+    __m256 ox = _mm256_set1_ps(ray.origin.x), oy = _mm256_set1_ps(ray.origin.y);
+    __m256 oz = _mm256_set1_ps(ray.origin.z);
+    __m256 dx = _mm256_set1_ps(ray.direction.x), dy = _mm256_set1_ps(ray.direction.y);
+    __m256 dz = _mm256_set1_ps(ray.direction.z);
+    __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), eps = _mm256_set1_ps(epsilon);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 e1x = _mm256_loadu_ps(&t.e1x[i]), e1y = _mm256_loadu_ps(&t.e1y[i]);
+        __m256 e1z = _mm256_loadu_ps(&t.e1z[i]);
+        __m256 e2x = _mm256_loadu_ps(&t.e2x[i]), e2y = _mm256_loadu_ps(&t.e2y[i]);
+        __m256 e2z = _mm256_loadu_ps(&t.e2z[i]);
+
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                                   _mm256_mul_ps(e1z, pz));
+        __m256 mask = _mm256_cmp_ps(det, eps, _CMP_GT_OQ);
+        if (!_mm256_movemask_ps(mask)) {
+            continue;
+        }
+        __m256 inv_det = _mm256_div_ps(one, det);
+
+        __m256 sx = _mm256_sub_ps(ox, _mm256_loadu_ps(&t.v0x[i]));
+        __m256 sy = _mm256_sub_ps(oy, _mm256_loadu_ps(&t.v0y[i]));
+        __m256 sz = _mm256_sub_ps(oz, _mm256_loadu_ps(&t.v0z[i]));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px),
+                                                             _mm256_mul_ps(sy, py)),
+                                               _mm256_mul_ps(sz, pz)),
+                                 inv_det);
+        mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                 _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx),
+                                                             _mm256_mul_ps(dy, qy)),
+                                               _mm256_mul_ps(dz, qz)),
+                                 inv_det);
+        mask = _mm256_and_ps(mask,
+                             _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                           _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+        __m256 distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx),
+                                                                    _mm256_mul_ps(e2y, qy)),
+                                                      _mm256_mul_ps(e2z, qz)),
+                                        inv_det);
+        mask = _mm256_and_ps(
+            mask, _mm256_and_ps(_mm256_cmp_ps(distance, eps, _CMP_GT_OQ),
+                                _mm256_cmp_ps(distance, _mm256_set1_ps(hit.t), _CMP_LT_OQ)));
+
+        int lanes = _mm256_movemask_ps(mask);
+        if (lanes) {
+            alignas(32) float distances[8];
+            _mm256_store_ps(distances, distance);
+            for (int lane = 0; lane < 8; ++lane) {
+                if (lanes & (1 << lane)) {
+                    keep_nearest(hit, t, i + lane, distances[lane]);
+                }
+            }
+        }
+    }
+
+    RayHit tail = intersect_scalar(ray, t, i, end);
+    return tail.t < hit.t ? tail : hit;
+}
+
+// Packet of 4 rays against one triangle at a time, each lane keeps its own nearest hit.
+void intersect_packet_sse(const Ray *rays, const TriangleSoA &t, RayHit *hits) {
+    __m128 ox = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+    __m128 oy = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+    __m128 oz = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+    __m128 dx = _mm_setr_ps(rays[0].direction.x, rays[1].direction.x, rays[2].direction.x,
+                            rays[3].direction.x);
+    __m128 dy = _mm_setr_ps(rays[0].direction.y, rays[1].direction.y, rays[2].direction.y,
+                            rays[3].direction.y);
+    __m128 dz = _mm_setr_ps(rays[0].direction.z, rays[1].direction.z, rays[2].direction.z,
+                            rays[3].direction.z);
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), eps = _mm_set1_ps(epsilon);
+    __m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128 best_index = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (int i = 0; i < size(t); ++i) {
+        __m128 e1x = _mm_set1_ps(t.e1x[i]), e1y = _mm_set1_ps(t.e1y[i]);
+        __m128 e1z = _mm_set1_ps(t.e1z[i]);
+        __m128 e2x = _mm_set1_ps(t.e2x[i]), e2y = _mm_set1_ps(t.e2y[i]);
+        __m128 e2z = _mm_set1_ps(t.e2z[i]);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                                _mm_mul_ps(e1z, pz));
+        __m128 mask = _mm_cmpgt_ps(det, eps);
+        if (!_mm_movemask_ps(mask)) {
+            continue;
+        }
+        __m128 inv_det = _mm_div_ps(one, det);
+
+        __m128 sx = _mm_sub_ps(ox, _mm_set1_ps(t.v0x[i]));
+        __m128 sy = _mm_sub_ps(oy, _mm_set1_ps(t.v0y[i]));
+        __m128 sz = _mm_sub_ps(oz, _mm_set1_ps(t.v0z[i]));
+        __m128 u = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)),
+            inv_det);
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 v = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)),
+            inv_det);
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero),
+                                           _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+        __m128 distance = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+            inv_det);
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(distance, eps),
+                                           _mm_cmplt_ps(distance, best)));
+
+        best = _mm_or_ps(_mm_and_ps(mask, distance), _mm_andnot_ps(mask, best));
+        __m128 index = _mm_castsi128_ps(_mm_set1_epi32(i));
+        best_index = _mm_or_ps(_mm_and_ps(mask, index), _mm_andnot_ps(mask, best_index));
+    }
+
+    alignas(16) float distances[4];
+    alignas(16) int indices[4];
+    _mm_store_ps(distances, best);
+    _mm_store_si128((__m128i *)indices, _mm_castps_si128(best_index));
+    for (int lane = 0; lane < 4; ++lane) {
+        hits[lane] = RayHit{};
+        if (indices[lane] >= 0) {
+            int i = indices[lane];
+            hits[lane] = {.t = distances[lane], .triangle = i, .id = t.id[i]};
+        }
+    }
+}
+
+__attribute__((target("avx"))) void intersect_packet_avx(const Ray *rays, const TriangleSoA &t,
+                                                        RayHit *hits) {
+    alignas(32) float lanes[6][8];
+    for (int lane = 0; lane < 8; ++lane) {
+        lanes[0][lane] = rays[lane].origin.x;
+        lanes[1][lane] = rays[lane].origin.y;
+        lanes[2][lane] = rays[lane].origin.z;
+        lanes[3][lane] = rays[lane].direction.x;
+        lanes[4][lane] = rays[lane].direction.y;
+        lanes[5][lane] = rays[lane].direction.z;
+    }
+    __m256 ox = _mm256_load_ps(lanes[0]), oy = _mm256_load_ps(lanes[1]);
+    __m256 oz = _mm256_load_ps(lanes[2]);
+    __m256 dx = _mm256_load_ps(lanes[3]), dy = _mm256_load_ps(lanes[4]);
+    __m256 dz = _mm256_load_ps(lanes[5]);
+    __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), eps = _mm256_set1_ps(epsilon);
+    __m256 best = _mm256_set1_ps(std::numeric_limits<float>::max());
+    __m256 best_index = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (int i = 0; i < size(t); ++i) {
+        __m256 e1x = _mm256_set1_ps(t.e1x[i]), e1y = _mm256_set1_ps(t.e1y[i]);
+        __m256 e1z = _mm256_set1_ps(t.e1z[i]);
+        __m256 e2x = _mm256_set1_ps(t.e2x[i]), e2y = _mm256_set1_ps(t.e2y[i]);
+        __m256 e2z = _mm256_set1_ps(t.e2z[i]);
+
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                                   _mm256_mul_ps(e1z, pz));
+        __m256 mask = _mm256_cmp_ps(det, eps, _CMP_GT_OQ);
+        if (!_mm256_movemask_ps(mask)) {
+            continue;
+        }
+        __m256 inv_det = _mm256_div_ps(one, det);
+
+        __m256 sx = _mm256_sub_ps(ox, _mm256_set1_ps(t.v0x[i]));
+        __m256 sy = _mm256_sub_ps(oy, _mm256_set1_ps(t.v0y[i]));
+        __m256 sz = _mm256_sub_ps(oz, _mm256_set1_ps(t.v0z[i]));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px),
+                                                             _mm256_mul_ps(sy, py)),
+                                               _mm256_mul_ps(sz, pz)),
+                                 inv_det);
+        mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                 _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx),
+                                                             _mm256_mul_ps(dy, qy)),
+                                               _mm256_mul_ps(dz, qz)),
+                                 inv_det);
+        mask = _mm256_and_ps(mask,
+                             _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                           _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+
+        __m256 distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx),
+                                                                    _mm256_mul_ps(e2y, qy)),
+                                                      _mm256_mul_ps(e2z, qz)),
+                                        inv_det);
+        mask = _mm256_and_ps(mask,
+                             _mm256_and_ps(_mm256_cmp_ps(distance, eps, _CMP_GT_OQ),
+                                           _mm256_cmp_ps(distance, best, _CMP_LT_OQ)));
+
+        best = _mm256_blendv_ps(best, distance, mask);
+        best_index = _mm256_blendv_ps(best_index, _mm256_castsi256_ps(_mm256_set1_epi32(i)), mask);
+    }
+
+    alignas(32) float distances[8];
+    alignas(32) int indices[8];
+    _mm256_store_ps(distances, best);
+    _mm256_store_si256((__m256i *)indices, _mm256_castps_si256(best_index));
+    for (int lane = 0; lane < 8; ++lane) {
+        hits[lane] = RayHit{};
+        if (indices[lane] >= 0) {
+            int i = indices[lane];
+            hits[lane] = {.t = distances[lane], .triangle = i, .id = t.id[i]};
+        }
+    }
+}
+
+SimdLevel detect_simd_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) {
+        return SimdLevel::AVX;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SimdLevel::SSE;
+    }
+    return SimdLevel::Scalar;
+}
+
+#else
+
+SimdLevel detect_simd_level() { return SimdLevel::Scalar; }
+
+#endif
+
+SimdLevel detected_simd_level = detect_simd_level();
+SimdLevel current_simd_level = detected_simd_level;
+
+SimdLevel simd_level() { return current_simd_level; }
+
+void set_simd_level(SimdLevel level) {
+    current_simd_level = level <= detected_simd_level ? level : detected_simd_level;
+}
+
+RayHit intersect(const Ray &ray, const TriangleSoA &triangles) {
+    return intersect(ray, triangles, 0, size(triangles));
+}
+
+RayHit intersect(const Ray &ray, const TriangleSoA &triangles, int begin, int end) {
+#ifdef RAYCAST_X86
+    switch (current_simd_level) {
+    case SimdLevel::AVX:
+        return intersect_avx(ray, triangles, begin, end);
+    case SimdLevel::SSE:
+        return intersect_sse(ray, triangles, begin, end);
+    case SimdLevel::Scalar:
+        break;
+    }
+#endif
+    return intersect_scalar(ray, triangles, begin, end);
+}
+
+void intersect(const std::vector<Ray> &rays, const TriangleSoA &triangles,
+               std::vector<RayHit> &hits) {
+    hits.resize(rays.size());
+    int i = 0;
+#ifdef RAYCAST_X86
+    if (current_simd_level == SimdLevel::AVX) {
+        for (; i + 8 <= rays.size(); i += 8) {
+            intersect_packet_avx(&rays[i], triangles, &hits[i]);
+        }
+    }
+    if (current_simd_level >= SimdLevel::SSE) {
+        for (; i + 4 <= rays.size(); i += 4) {
+            intersect_packet_sse(&rays[i], triangles, &hits[i]);
+        }
+    }
+#endif
+    for (; i < rays.size(); ++i) {
+        hits[i] = intersect_scalar(rays[i], triangles, 0, size(triangles));
+    }
+}
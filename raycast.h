@@ -0,0 +1,48 @@
+#pragma once
+
+#include "maths.h"
+
+#include <limits>
+#include <vector>
+
+struct Ray {
+    Vec3 origin;
+    Vec3 direction;
+};
+
+struct RayHit {
+    float t = std::numeric_limits<float>::max();
+    int triangle = -1;
+    int id = -1;
+};
+
+// Triangles stored component by component so that 4 or 8 of them are loaded at once. Edges are
+// precomputed for Moller-Trumbore, id is whatever the triangle belongs to (a cell, an entity...).
+struct TriangleSoA {
+    std::vector<float> v0x, v0y, v0z;
+    std::vector<float> e1x, e1y, e1z;
+    std::vector<float> e2x, e2y, e2z;
+    std::vector<int> id;
+};
+
+void clear(TriangleSoA &triangles);
+void add_triangle(TriangleSoA &triangles, Vec3 a, Vec3 b, Vec3 c, int id);
+int size(const TriangleSoA &triangles);
+
+// To fill the triangles from several threads, each writing its own range.
+void resize(TriangleSoA &triangles, int n);
+void set_triangle(TriangleSoA &triangles, int i, Vec3 a, Vec3 b, Vec3 c, int id);
+
+enum class SimdLevel { Scalar, SSE, AVX };
+
+// Detected from the CPU the first time, can be lowered to compare the implementations.
+SimdLevel simd_level();
+void set_simd_level(SimdLevel level);
+
+// Nearest front-facing triangle hit by the ray, triangles facing away are ignored.
+RayHit intersect(const Ray &ray, const TriangleSoA &triangles);
+RayHit intersect(const Ray &ray, const TriangleSoA &triangles, int begin, int end);
+
+// Same for many rays at once, the rays are tested in packets of 4 or 8 against each triangle.
+void intersect(const std::vector<Ray> &rays, const TriangleSoA &triangles,
+               std::vector<RayHit> &hits);
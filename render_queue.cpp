@@ -0,0 +1,106 @@
+#include "render_queue.h"
+
+#include "memory.h"
+#include "render_stats.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+
+void bind_frame_uniforms(StreamBuffer &stream, const FrameUniforms &frame) {
+    FrameBlock block;
+    std::memcpy(block.view, frame.view.ptr(), sizeof(block.view));
+    std::memcpy(block.projection, frame.projection.ptr(), sizeof(block.projection));
+    block.viewer_pos[0] = frame.camera_position.x;
+    block.viewer_pos[1] = frame.camera_position.y;
+    block.viewer_pos[2] = frame.camera_position.z;
+    block.padding = 0;
+    block.bake_scale[0] = frame.bake_scale.x;
+    block.bake_scale[1] = frame.bake_scale.y;
+    block.bake_scale[2] = frame.bake_scale.z;
+    block.bake_scale[3] = 0;
+
+    StreamAllocation allocation = upload(stream, &block, sizeof(block), stream.uniform_alignment);
+    if (allocation.data) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, frame_block_binding, stream.buffer,
+                          allocation.offset, sizeof(block));
+        render_stats().uniform_uploads++;
+    }
+}
+
+// 5:6:5 bits of the color, enough to keep draws of the same color together
+uint64_t material_bits(Vec3 color) {
+    auto bits = [](float c, int n) {
+        return (uint64_t)(std::min(std::max(c, 0.f), 1.f) * ((1 << n) - 1) + 0.5f);
+    };
+    return bits(color.x, 5) << 11 | bits(color.y, 6) << 5 | bits(color.z, 5);
+}
+
+uint64_t sort_key(RenderPass pass, unsigned int program, unsigned int VAO, Vec3 color) {
+    return (uint64_t)pass << 56 | (uint64_t)(program & 0xFFFF) << 40 |
+           (uint64_t)(VAO & 0xFFFFFF) << 16 | material_bits(color);
+}
+
+void submit(RenderQueue &queue, RenderPass pass, const Shader &shader,
+            const BasicRenderingBuffer &buffer, const Mat4 &model, Vec3 color) {
+    MemoryScope scope(MemoryTag::Render);
+    queue.entries.push_back({.key = sort_key(pass, shader.program, buffer.VAO, color),
+                             .item = (uint32_t)queue.items.size()});
+    queue.items.push_back({.program = shader.program,
+                           .VAO = buffer.VAO,
+                           .n_vertices = buffer.n_vertices,
+                           .model = model,
+                           .color = color});
+}
+
+void radix_sort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch) {
+    if (entries.empty()) {
+        return;
+    }
+    scratch.resize(entries.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        int counts[256] = {};
+        for (const SortEntry &entry : entries) {
+            counts[(entry.key >> shift) & 0xFF]++;
+        }
+        if (counts[(entries[0].key >> shift) & 0xFF] == (int)entries.size()) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int &count : counts) {
+            int n = count;
+            count = offset;
+            offset += n;
+        }
+        for (const SortEntry &entry : entries) {
+            scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void record(RenderQueue &queue, CommandList &list) {
+    radix_sort(queue.entries, queue.scratch);
+    for (const SortEntry &entry : queue.entries) {
+        const DrawItem &item = queue.items[entry.item];
+        bind_program(list, item.program);
+        bind_vertex_array(list, item.VAO);
+        set_model(list, item.model);
+        set_color(list, item.color);
+        draw(list, 0, item.n_vertices);
+    }
+    queue.items.clear();
+    queue.entries.clear();
+}
+
+void execute(RenderQueue &queue, CommandBackend &backend) {
+    if (queue.items.empty()) {
+        return;
+    }
+    clear(queue.commands);
+    record(queue, queue.commands);
+    replay(backend, queue.commands);
+    finish_replay(backend);
+}
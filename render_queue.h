@@ -0,0 +1,73 @@
+#pragma once
+
+#include "buffer.h"
+#include "command_list.h"
+#include "maths.h"
+#include "stream_buffer.h"
+
+#include <cstdint>
+#include <vector>
+
+// Draws are submitted during the frame and sorted by key before being recorded, so that draws
+// with the same program and vertex array follow each other and the binds between them are left
+// out of the command list. From the highest bits the key is the pass (8), the program (16), the
+// vertex array (24) and the material (16).
+
+enum class RenderPass : uint8_t { Opaque, Decal };
+
+struct DrawItem {
+    unsigned int program;
+    unsigned int VAO;
+    int n_vertices;
+    Mat4 model;
+    Vec3 color;
+};
+
+// Same for every draw of the frame
+struct FrameUniforms {
+    Mat4 view;
+    Mat4 projection;
+    Vec3 camera_position;
+    Vec3 bake_scale; // see bake_scale in bake.h
+    uint32_t features; // ShaderFeature of the lit programs
+};
+
+// std140 layout of the uniform block Frame of the shaders, declared row_major like Mat4
+struct FrameBlock {
+    float view[16];
+    float projection[16];
+    float viewer_pos[3];
+    float padding; // vec4 are aligned on 16 bytes
+    float bake_scale[4];
+};
+
+// Writes the frame uniforms to the stream buffer and binds them for every program.
+void bind_frame_uniforms(StreamBuffer &stream, const FrameUniforms &frame);
+
+struct SortEntry {
+    uint64_t key;
+    uint32_t item;
+};
+
+struct RenderQueue {
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    CommandList commands;
+};
+
+uint64_t sort_key(RenderPass pass, unsigned int program, unsigned int VAO, Vec3 color);
+
+void submit(RenderQueue &queue, RenderPass pass, const Shader &shader,
+            const BasicRenderingBuffer &buffer, const Mat4 &model, Vec3 color);
+
+// LSD radix sort on the keys, 8 bits at a time. Bytes that are the same in every key are skipped,
+// which is most of them with a few programs and vertex arrays.
+void radix_sort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch);
+
+// Sorts the draws into the list and empties the queue, without calling GL so that each worker
+// thread can record its own queue.
+void record(RenderQueue &queue, CommandList &list);
+
+// Records and replays right away on the GL thread. The frame uniforms must be bound.
+void execute(RenderQueue &queue, CommandBackend &backend);
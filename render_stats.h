@@ -0,0 +1,20 @@
+#pragma once
+
+// What was sent to GL during the frame, reset by the main loop at the start of each frame.
+struct RenderStats {
+    int draw_calls = 0;
+    int triangles = 0;
+    int uniform_uploads = 0;
+    int grid_blocks = 0;
+    int state_changes = 0;
+    int state_changes_avoided = 0; // binds and uniforms already set
+    long stream_bytes = 0;         // written to the stream buffer
+    int stream_waits = 0;          // times the CPU waited for the GPU to free a stream region
+    int lights = 0;
+    int light_indices = 0; // lights summed over the clusters
+};
+
+inline RenderStats &render_stats() {
+    static RenderStats stats;
+    return stats;
+}
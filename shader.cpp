@@ -1,9 +1,14 @@
 #include "shader.h"
 
 #include "maths.h"
+#include "memory.h"
+#include "render_stats.h"
 
 #include <GL/glew.h>
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <stdexcept>
 
@@ -14,8 +19,28 @@ std::string read_from_file(const std::string &path) {
     return buffer.str();
 }
 
-Shader compile(const std::string &vertex, const std::string &fragment) {
-    std::string vertex_source = read_from_file(vertex);
+// version replaces the #version line of the source when it is higher.
+std::string with_defines(const std::string &source, const std::string &defines, int version = 0) {
+    if (defines.empty()) {
+        return source;
+    }
+    // #version must stay the first line
+    size_t line_end = source.find('\n');
+    if (line_end == std::string::npos) {
+        return source + "\n" + defines;
+    }
+    std::string version_line = source.substr(0, line_end + 1);
+    int source_version = 0;
+    std::sscanf(version_line.c_str(), "#version %d", &source_version);
+    if (version > source_version) {
+        version_line = "#version " + std::to_string(version) + " core\n";
+    }
+    return version_line + defines + source.substr(line_end + 1);
+}
+
+Shader compile(const std::string &vertex, const std::string &fragment,
+               const std::string &defines, int version) {
+    std::string vertex_source = with_defines(read_from_file(vertex), defines, version);
     GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
     auto source = vertex_source.c_str();
     glShaderSource(vertex_shader, 1, &source, NULL);
@@ -29,7 +54,7 @@ Shader compile(const std::string &vertex, const std::string &fragment) {
         throw std::runtime_error(std::string("Vertex shader: ") + log);
     }
 
-    std::string fragment_source = read_from_file(fragment);
+    std::string fragment_source = with_defines(read_from_file(fragment), defines, version);
     source = fragment_source.c_str();
     GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment_shader, 1, &source, NULL);
@@ -56,29 +81,79 @@ Shader compile(const std::string &vertex, const std::string &fragment) {
     }
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+
+    GLuint frame_block = glGetUniformBlockIndex(shader.program, "Frame");
+    if (frame_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader.program, frame_block, frame_block_binding);
+    }
     return shader;
 }
 
+ShaderVariants make_shader_variants(const std::string &vertex, const std::string &fragment) {
+    return {.vertex = vertex, .fragment = fragment};
+}
+
+struct FeatureDefine {
+    const char *name;
+    int version; // of GLSL needed, 0 for any
+};
+
+const FeatureDefine feature_defines[] = {
+    {"SHOW_NORMALS", 0},
+    {"SPECULAR", 0},
+    {"TELEPORTATION_SPOT", 0},
+    {"CLUSTERED_LIGHTS", 430},
+    {"BAKED_LIGHT", 0},
+};
+
+const Shader &variant(ShaderVariants &variants, uint32_t features) {
+    auto it = variants.compiled.find(features);
+    if (it == variants.compiled.end()) {
+        MemoryScope scope(MemoryTag::Render);
+        std::string defines;
+        int version = 0;
+        for (int bit = 0; bit < std::size(feature_defines); ++bit) {
+            if (features & (1u << bit)) {
+                defines += std::string("#define ") + feature_defines[bit].name + "\n";
+                version = std::max(version, feature_defines[bit].version);
+            }
+        }
+        Shader shader = compile(variants.vertex, variants.fragment, defines, version);
+        it = variants.compiled.emplace(features, shader).first;
+    }
+    return it->second;
+}
+
 // void use(const Shader &shader) { glUseProgram(shader.program); }
 
-void set_matrix4(const Shader &shader, const std::string &name, const Mat4 &matrix) {
-    int loc = glGetUniformLocation(shader.program, name.c_str());
+void set_matrix4(const Shader &shader, const char *name, const Mat4 &matrix) {
+    int loc = glGetUniformLocation(shader.program, name);
+    render_stats().uniform_uploads++;
     glUniformMatrix4fv(loc, 1, GL_TRUE, matrix.ptr());
 }
 
-void set_vec3(const Shader &shader, const std::string &name, const Vec3 &vec) {
-    int loc = glGetUniformLocation(shader.program, name.c_str());
+void set_vec3(const Shader &shader, const char *name, const Vec3 &vec) {
+    int loc = glGetUniformLocation(shader.program, name);
+    render_stats().uniform_uploads++;
     float v[] = {vec.x, vec.y, vec.z};
     glUniform3fv(loc, 1, v);
 }
 
-void set_int(const Shader &shader, const std::string &name, int value) {
-    int loc = glGetUniformLocation(shader.program, name.c_str());
+void set_vec2(const Shader &shader, const char *name, float x, float y) {
+    int loc = glGetUniformLocation(shader.program, name);
+    render_stats().uniform_uploads++;
+    glUniform2f(loc, x, y);
+}
+
+void set_int(const Shader &shader, const char *name, int value) {
+    int loc = glGetUniformLocation(shader.program, name);
+    render_stats().uniform_uploads++;
     glUniform1i(loc, value);
 }
 
-void set_float(const Shader &shader, const std::string &name, float value) {
-    int loc = glGetUniformLocation(shader.program, name.c_str());
+void set_float(const Shader &shader, const char *name, float value) {
+    int loc = glGetUniformLocation(shader.program, name);
+    render_stats().uniform_uploads++;
     glUniform1f(loc, value);
 }
 
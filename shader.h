@@ -1,20 +1,50 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 
 class Mat4;
 class Vec3;
 
+// Binding point of the uniform block Frame declared by the shaders, filled once per frame
+constexpr unsigned int frame_block_binding = 0;
+
 struct Shader {
     unsigned int program;
 };
 
-Shader compile(const std::string &vertex, const std::string &fragment);
+// defines is inserted in both sources after their #version line, which is raised to version if it
+// is lower.
+Shader compile(const std::string &vertex, const std::string &fragment,
+               const std::string &defines = "", int version = 0);
+
+// Optional parts of a shader, compiled in with a #define of the same name in upper case instead of
+// branching on a uniform for every fragment.
+enum ShaderFeature : uint32_t {
+    ShowNormals = 1 << 0,
+    Specular = 1 << 1,
+    TeleportationSpot = 1 << 2,
+    ClusteredLights = 1 << 3, // raises the shaders to GLSL 4.30 for the storage buffers
+    BakedLight = 1 << 4,      // ambient occlusion and sun shadows from bake.h
+};
+
+// Variants of one program by feature mask, each compiled the first time it is asked for.
+struct ShaderVariants {
+    std::string vertex;
+    std::string fragment;
+    std::unordered_map<uint32_t, Shader> compiled;
+};
+
+ShaderVariants make_shader_variants(const std::string &vertex, const std::string &fragment);
+// Compiles on the first call for the mask, so only on the GL thread.
+const Shader &variant(ShaderVariants &variants, uint32_t features);
 
-void set_matrix4(const Shader &shader, const std::string &name, const Mat4 &matrix);
-void set_vec3(const Shader &shader, const std::string &name, const Vec3 &vec);
-void set_int(const Shader &shader, const std::string &name, int value);
-void set_float(const Shader &shader, const std::string &name, float value);
+void set_matrix4(const Shader &shader, const char *name, const Mat4 &matrix);
+void set_vec3(const Shader &shader, const char *name, const Vec3 &vec);
+void set_vec2(const Shader &shader, const char *name, float x, float y);
+void set_int(const Shader &shader, const char *name, int value);
+void set_float(const Shader &shader, const char *name, float value);
 
 // RAII to disable shader at end of scope
 class UseShader {
@@ -1,10 +0,0 @@
-#version 330 core
-
-layout (location = 0) in vec3 coord;
-
-uniform mat4 view;
-uniform mat4 projection;
-
-void main(void) {
-  gl_Position = projection * view * vec4(coord, 1.0);
-}
\ No newline at end of file
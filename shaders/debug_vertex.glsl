@@ -0,0 +1,26 @@
+#version 330 core
+
+// xyz and 1 in world space, or clip coordinates and 0
+layout (location = 0) in vec4 coord;
+// rgb and the size of points
+layout (location = 1) in vec4 color_size;
+
+// Set once per frame for every program, see FrameBlock in render_queue.h
+layout (std140, row_major) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewer_pos;
+    vec4 bake_scale; // world position to texture coordinates of the baked lighting
+};
+
+out vec3 color;
+
+void main(void) {
+    if (coord.w > 0.5) {
+        gl_Position = projection * view * vec4(coord.xyz, 1.0);
+    } else {
+        gl_Position = vec4(coord.xyz, 1.0);
+    }
+    gl_PointSize = color_size.w;
+    color = color_size.rgb;
+}
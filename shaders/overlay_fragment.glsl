@@ -0,0 +1,12 @@
+#version 330
+
+uniform sampler2D atlas;
+
+in vec2 uv;
+in vec4 color;
+
+out vec4 FragColor;
+
+void main(void) {
+    FragColor = vec4(color.rgb, color.a * texture(atlas, uv).r);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+layout (location = 0) in vec2 coord;
+layout (location = 1) in vec2 uv_;
+layout (location = 2) in vec4 color_;
+
+// In pixels, origin at the top left
+uniform vec2 screen_size;
+
+out vec2 uv;
+out vec4 color;
+
+void main(void) {
+    vec2 ndc = coord / screen_size * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    uv = uv_;
+    color = color_;
+}
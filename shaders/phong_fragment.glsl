@@ -1,14 +1,26 @@
 #version 330
 
 
-uniform vec3 color;
-uniform vec3 viewer_pos;
+// Set once per frame for every program, see FrameBlock in render_queue.h
+layout (std140, row_major) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewer_pos;
+    vec4 bake_scale; // world position to texture coordinates of the baked lighting
+};
+
+#ifdef TELEPORTATION_SPOT
 uniform vec3 teleportation_target;
-uniform int show_teleportation;
-uniform int show_normals;
+#endif
+
+#ifdef BAKED_LIGHT
+// Ambient occlusion in r and sun visibility in g, see bake.h
+uniform sampler3D baked;
+#endif
 
 in vec3 normal;
 in vec3 pos;
+in vec3 object_color;
 
 out vec4 FragColor;
 
@@ -17,34 +29,101 @@ float rand(vec2 co){
     return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
 }
 
-void main(void) {
+#ifdef SPECULAR
+float specular(vec3 light_dir, vec3 viewer_dir) {
     const float PI = 3.1415926535897932384626433832795;
+    // Exponent of 10 with multiplications instead of pow
+    const float n = 10;
+    float x = max(0.0, dot(-reflect(light_dir, normal), viewer_dir));
+    float x2 = x * x;
+    float x8 = x2 * x2 * x2 * x2;
+    return ((n + 8.0) / (8.0*PI)) * x8 * x2;
+}
+#endif
 
-    vec3 light_pos = vec3(5, 10, 15);
-    vec3 light_dir = normalize(light_pos - pos);
+// Diffuse and specular light received from one direction
+vec3 direct(vec3 light_dir, vec3 light_color, vec3 viewer_dir) {
+    vec3 lit = 0.7 * max(0, dot(light_dir, normal)) * object_color;
+#ifdef SPECULAR
+    lit += 0.2 * specular(light_dir, viewer_dir) * object_color;
+#endif
+    return lit * light_color;
+}
+
+#ifdef CLUSTERED_LIGHTS
+// Same as lights.h
+const int cluster_tiles_x = 16;
+const int cluster_tiles_y = 9;
+const int cluster_slices = 24;
+
+struct PointLight {
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout (std430, binding = 1) readonly buffer Lights {
+    PointLight lights[];
+};
 
-    float diff = max(0, dot(light_dir, normal));
+layout (std430, binding = 2) readonly buffer Clusters {
+    vec4 cluster_params; // near, slices per log(depth / near), tiles per pixel in x and y
+    uvec2 clusters[];    // first index in light_indices and number of lights
+};
 
-    vec3 light_dir_reflected = reflect(light_dir, normal);
+layout (std430, binding = 3) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
+vec3 point_lights(vec3 viewer_dir) {
+    float depth = -(view * vec4(pos, 1.0)).z;
+    int slice = clamp(int(log(depth / cluster_params.x) * cluster_params.y), 0, cluster_slices - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy * cluster_params.zw), ivec2(0),
+                       ivec2(cluster_tiles_x - 1, cluster_tiles_y - 1));
+    uvec2 range = clusters[(slice * cluster_tiles_y + tile.y) * cluster_tiles_x + tile.x];
+
+    vec3 sum = vec3(0);
+    for (uint i = range.x; i < range.x + range.y; ++i) {
+        PointLight light = lights[light_indices[i]];
+        vec3 to_light = light.position_radius.xyz - pos;
+        float d2 = max(dot(to_light, to_light), 1e-4);
+        float r = light.position_radius.w;
+        // Goes smoothly to 0 at the radius
+        float falloff = clamp(1.0 - d2 / (r * r), 0.0, 1.0);
+        sum += direct(to_light * inversesqrt(d2), light.color.rgb * falloff * falloff, viewer_dir);
+    }
+    return sum;
+}
+#endif
+
+// Variants are compiled with SHOW_NORMALS, SPECULAR, TELEPORTATION_SPOT, CLUSTERED_LIGHTS and
+// BAKED_LIGHT defined or not, see ShaderFeature in shader.h
+void main(void) {
+#ifdef SHOW_NORMALS
+    FragColor = vec4((normal + 1.f) / 2.f, 1.0);
+#else
+    vec3 light_pos = vec3(5, 10, 15);
+    vec3 light_dir = normalize(light_pos - pos);
     vec3 viewer_dir = normalize(viewer_pos - pos);
-    float n = 10;
-    float spec = ((n + 8.0) / (8.0*PI)) * pow(max(0.0, dot(-light_dir_reflected, viewer_dir)), n);
 
     vec3 light_color = vec3(1., 1., 1.);
-    vec3 ambient = 0.3 * light_color;
-    vec3 diffuse = 0.7 * diff * light_color;
-    vec3 specular = 0.2 * spec * light_color;
+    vec3 ambient = 0.3 * light_color * object_color;
+    vec3 sun = direct(light_dir, light_color, viewer_dir);
+#ifdef BAKED_LIGHT
+    // Slightly off the surface so that the samples behind it do not darken it
+    vec2 bake = texture(baked, (pos + 0.25 * normal) * bake_scale.xyz).rg;
+    ambient *= bake.r;
+    sun *= bake.g;
+#endif
+    vec3 phong_color = ambient + sun;
+#ifdef CLUSTERED_LIGHTS
+    phong_color += point_lights(viewer_dir);
+#endif
 
     //    float noise = rand(pos.xy) * 0.2;
-    if (show_normals > 0) {
-        vec3 nor = (normal + 1.f) / 2.f;
-        FragColor = vec4(nor, 1.0);
-    } else {
-        vec3 phong_color = (ambient + diffuse + specular) * color;
-        vec3 spot = vec3(0);
-        if (show_teleportation > 0) {
-            spot = max(vec3(0.f), vec3(1) * (1-length(pos - teleportation_target)));
-        }
-        FragColor = vec4(phong_color + 0.3 * spot, 1.);
-    }
-}
\ No newline at end of file
+#ifdef TELEPORTATION_SPOT
+    vec3 spot = max(vec3(0.f), vec3(1) * (1-length(pos - teleportation_target)));
+    phong_color += 0.3 * spot;
+#endif
+    FragColor = vec4(phong_color, 1.);
+#endif
+}
@@ -0,0 +1,39 @@
+#version 430 core
+
+// Same as phong_vertex.glsl for the static world drawn with one multi-draw, the model and the
+// color of each draw come from a storage buffer.
+
+layout (location = 0) in vec3 coord;
+layout (location = 1) in vec3 normal_;
+// Instanced attribute, the draw command sets its base instance to the index of the draw
+layout (location = 2) in uint draw_id;
+
+struct Draw {
+    mat4 model;
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+    Draw draws[];
+};
+
+// Set once per frame for every program, see FrameBlock in render_queue.h
+layout (std140, row_major) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewer_pos;
+    vec4 bake_scale; // world position to texture coordinates of the baked lighting
+};
+
+out vec3 normal;
+out vec3 pos;
+out vec3 object_color;
+
+void main(void) {
+    mat4 model = draws[draw_id].model;
+    vec4 coord_model = model * vec4(coord, 1.0);
+    gl_Position = projection * view * coord_model;
+    pos = vec3(coord_model);
+    normal = mat3(transpose(inverse(model))) * normal_;
+    object_color = draws[draw_id].color.rgb;
+}
@@ -4,15 +4,23 @@ layout (location = 0) in vec3 coord;
 layout (location = 1) in vec3 normal_;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Set once per frame for every program, see FrameBlock in render_queue.h
+layout (std140, row_major) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewer_pos;
+    vec4 bake_scale; // world position to texture coordinates of the baked lighting
+};
+uniform vec3 color;
 
 out vec3 normal;
 out vec3 pos;
+out vec3 object_color;
 
 void main(void) {
     vec4 coord_model = model * vec4(coord, 1.0);
     gl_Position = projection * view * coord_model;
     pos = vec3(coord_model);
     normal = mat3(transpose(inverse(model))) * normal_;
+    object_color = color;
 }
\ No newline at end of file
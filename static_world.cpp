@@ -0,0 +1,158 @@
+#include "static_world.h"
+
+#include "memory.h"
+#include "parallel.h"
+#include "render_stats.h"
+
+#include <GL/glew.h>
+
+// Layout of glMultiDrawArraysIndirect
+struct DrawArraysIndirectCommand {
+    unsigned int count;
+    unsigned int instance_count;
+    unsigned int first;
+    unsigned int base_instance;
+};
+
+// std430 layout of Draw in phong_indirect_vertex.glsl, the matrix is column-major
+struct DrawData {
+    float model[16];
+    float color[4];
+};
+
+StaticWorld make_static_world() {
+    StaticWorld world;
+    // The shader is #version 430 and needs the base instance of each draw
+    world.supported = GLEW_VERSION_4_3;
+    if (!world.supported) {
+        return world;
+    }
+
+    MemoryScope scope(MemoryTag::Render);
+    world.shader =
+        make_shader_variants("shaders/phong_indirect_vertex.glsl", "shaders/phong_fragment.glsl");
+    glGenVertexArrays(1, &world.VAO);
+    glGenBuffers(1, &world.VBO);
+    glGenBuffers(1, &world.draw_ids);
+    glGenBuffers(1, &world.draws_buffer);
+
+    glBindVertexArray(world.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, world.VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, world.draw_ids);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, 0, (void *)0);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    return world;
+}
+
+void free_static_world(StaticWorld &world) {
+    if (!world.supported) {
+        return;
+    }
+    track_gpu_memory(MemoryTag::Render, -world.gpu_bytes);
+    unsigned int buffers[] = {world.VBO, world.draw_ids, world.draws_buffer};
+    glDeleteBuffers(3, buffers);
+    glDeleteVertexArrays(1, &world.VAO);
+    world = StaticWorld{};
+}
+
+void update_static_world(StaticWorld &world, const Grid &grid) {
+    if (!world.supported || world.built_version == grid.version) {
+        return;
+    }
+    world.built_version = grid.version;
+    MemoryScope scope(MemoryTag::Render);
+
+    world.draws.clear();
+    for (const auto &[id, block] : grid.blocks) {
+        world.draws.push_back({.block = id, .min = block.min, .max = block.max});
+    }
+    int n = world.draws.size();
+
+    std::vector<Mesh> visible(n);
+    parallel_for(0, n, [&](int i) {
+        int id = world.draws[i].block;
+        visible[i] = visible_mesh(grid.hidden_faces, id, grid.blocks.at(id).entity.mesh);
+    }, 16);
+    int n_vertices = 0;
+    for (int i = 0; i < n; ++i) {
+        world.draws[i].first = n_vertices;
+        world.draws[i].count = visible[i].vertices.size();
+        n_vertices += world.draws[i].count;
+    }
+
+    std::vector<float> packed(n_vertices * floats_per_vertex);
+    std::vector<DrawData> draw_data(n);
+    std::vector<unsigned int> draw_ids(n);
+    parallel_for(0, n, [&](int i) {
+        float *vertices = packed.data() + world.draws[i].first * floats_per_vertex;
+        pack_vertices_and_normals(visible[i], vertices);
+        const Entity &entity = grid.blocks.at(world.draws[i].block).entity;
+        for (int row = 0; row < 4; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                draw_data[i].model[col * 4 + row] = entity.transform.val(row, col);
+            }
+        }
+        draw_data[i].color[0] = entity.color.x;
+        draw_data[i].color[1] = entity.color.y;
+        draw_data[i].color[2] = entity.color.z;
+        draw_data[i].color[3] = 1;
+        draw_ids[i] = i;
+    }, 16);
+
+    long bytes = packed.size() * sizeof(float) + n * (sizeof(DrawData) + sizeof(unsigned int));
+    track_gpu_memory(MemoryTag::Render, bytes - world.gpu_bytes);
+    world.gpu_bytes = bytes;
+
+    glBindBuffer(GL_ARRAY_BUFFER, world.VBO);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(float), packed.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, world.draw_ids);
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(unsigned int), draw_ids.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, world.draws_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(DrawData), draw_data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void draw(StaticWorld &world, StreamBuffer &stream, const Frustum &frustum, uint32_t features) {
+    auto commands = make_frame_vector<DrawArraysIndirectCommand>(world.draws.size());
+    for (int i = 0; i < world.draws.size(); ++i) {
+        const StaticDraw &d = world.draws[i];
+        if (!intersects(frustum, d.min, d.max)) {
+            continue;
+        }
+        commands.push_back({.count = (unsigned int)d.count,
+                            .instance_count = 1,
+                            .first = (unsigned int)d.first,
+                            .base_instance = (unsigned int)i});
+    }
+    if (commands.empty()) {
+        return;
+    }
+
+    StreamAllocation allocation =
+        upload(stream, commands.data(), commands.size() * sizeof(DrawArraysIndirectCommand));
+    if (!allocation.data) {
+        return;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, world.draws_buffer);
+
+    UseShader use(variant(world.shader, features).program);
+    glBindVertexArray(world.VAO);
+    glMultiDrawArraysIndirect(GL_TRIANGLES, (void *)allocation.offset, commands.size(), 0);
+    render_stats().draw_calls++;
+    render_stats().grid_blocks += commands.size();
+    for (const auto &command : commands) {
+        render_stats().triangles += command.count / 3;
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "frustum.h"
+#include "grid.h"
+#include "render_queue.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+#include <vector>
+
+// The blocks of the grid in one shared vertex buffer, drawn with a single
+// glMultiDrawArraysIndirect. The model and color of each block are in a storage buffer indexed by
+// the draw, only the commands of the visible blocks are uploaded each frame. Needs GL 4.3,
+// otherwise supported is false and the blocks go through the render queue.
+
+struct StaticDraw {
+    int block; // id in grid.blocks
+    int first; // first vertex in the shared buffer
+    int count;
+    Vec3 min;
+    Vec3 max;
+};
+
+struct StaticWorld {
+    bool supported = false;
+    unsigned int VAO{};
+    unsigned int VBO{};
+    unsigned int draw_ids{};
+    unsigned int draws_buffer{}; // storage buffer of model and color
+    ShaderVariants shader;
+    std::vector<StaticDraw> draws;
+    int built_version = -1;
+    long gpu_bytes = 0;
+};
+
+StaticWorld make_static_world();
+void free_static_world(StaticWorld &world);
+
+// Uploads the blocks again if the grid changed since the last call.
+void update_static_world(StaticWorld &world, const Grid &grid);
+
+// One draw call for the visible blocks, their commands are written to the stream buffer.
+void draw(StaticWorld &world, StreamBuffer &stream, const Frustum &frustum, uint32_t features);
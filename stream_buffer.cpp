@@ -0,0 +1,165 @@
+#include "stream_buffer.h"
+
+#include "logging.h"
+#include "memory.h"
+#include "render_stats.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Binding point used to write the buffer, so that the vertex array or indirect buffer bound by
+// the caller are not changed
+constexpr GLenum stream_target = GL_COPY_WRITE_BUFFER;
+
+long total_size(const StreamBuffer &stream) {
+    return stream.persistent ? stream.frame_size * stream_frames : stream.frame_size;
+}
+
+void create_storage(StreamBuffer &stream) {
+    glGenBuffers(1, &stream.buffer);
+    glBindBuffer(stream_target, stream.buffer);
+    if (stream.persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(stream_target, total_size(stream), nullptr, flags);
+        stream.mapped = (char *)glMapBufferRange(stream_target, 0, total_size(stream), flags);
+    } else {
+        glBufferData(stream_target, total_size(stream), nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(stream_target, 0);
+    track_gpu_memory(MemoryTag::Render, total_size(stream));
+}
+
+void destroy_storage(StreamBuffer &stream) {
+    for (void *&fence : stream.fences) {
+        if (fence) {
+            glDeleteSync((GLsync)fence);
+            fence = nullptr;
+        }
+    }
+    if (stream.mapped) {
+        glBindBuffer(stream_target, stream.buffer);
+        glUnmapBuffer(stream_target);
+        glBindBuffer(stream_target, 0);
+        stream.mapped = nullptr;
+    }
+    glDeleteBuffers(1, &stream.buffer);
+    track_gpu_memory(MemoryTag::Render, -total_size(stream));
+}
+
+// The regions start at multiples of the frame size, offsets in them must stay aligned for binding
+long aligned_frame_size(const StreamBuffer &stream, long size) {
+    long alignment = std::max(stream.uniform_alignment, stream.storage_alignment);
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+StreamBuffer make_stream_buffer(long frame_size) {
+    StreamBuffer stream;
+    stream.persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    stream.uniform_alignment = std::max(alignment, 16);
+    if (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object) {
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stream.storage_alignment = std::max(alignment, 16);
+    }
+    stream.frame_size = aligned_frame_size(stream, frame_size);
+    create_storage(stream);
+    return stream;
+}
+
+void free_stream_buffer(StreamBuffer &stream) {
+    destroy_storage(stream);
+    stream = StreamBuffer{};
+}
+
+void wait_for_frame(StreamBuffer &stream, int frame) {
+    GLsync fence = (GLsync)stream.fences[frame];
+    if (!fence) {
+        return;
+    }
+    // Only blocks when the CPU is stream_frames frames ahead of the GPU
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        render_stats().stream_waits++;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    stream.fences[frame] = nullptr;
+}
+
+void begin_frame(StreamBuffer &stream) {
+    if (stream.needed > stream.frame_size) {
+        for (int frame = 0; frame < stream_frames; ++frame) {
+            wait_for_frame(stream, frame);
+        }
+        destroy_storage(stream);
+        log("stream buffer grows to " + std::to_string(stream.needed) + " bytes per frame");
+        stream.frame_size = aligned_frame_size(stream, stream.needed + stream.needed / 2);
+        create_storage(stream);
+    }
+    stream.offset = 0;
+    stream.needed = 0;
+
+    if (stream.persistent) {
+        wait_for_frame(stream, stream.frame);
+    } else {
+        // The driver gives new storage, the previous one is freed once the GPU is done with it
+        glBindBuffer(stream_target, stream.buffer);
+        glBufferData(stream_target, stream.frame_size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(stream_target, 0);
+    }
+}
+
+void end_frame(StreamBuffer &stream) {
+    if (stream.persistent) {
+        stream.fences[stream.frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        stream.frame = (stream.frame + 1) % stream_frames;
+    }
+}
+
+StreamAllocation allocate(StreamBuffer &stream, long size, long alignment) {
+    long start = (stream.offset + alignment - 1) / alignment * alignment;
+    stream.needed = std::max(stream.needed, start + size);
+    if (start + size > stream.frame_size) {
+        return {};
+    }
+    stream.offset = start + size;
+    render_stats().stream_bytes += size;
+
+    StreamAllocation allocation;
+    allocation.size = size;
+    if (stream.persistent) {
+        allocation.offset = stream.frame * stream.frame_size + start;
+        allocation.data = stream.mapped + allocation.offset;
+    } else {
+        allocation.offset = start;
+        glBindBuffer(stream_target, stream.buffer);
+        allocation.data = glMapBufferRange(stream_target, start, size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                               GL_MAP_INVALIDATE_RANGE_BIT);
+        glBindBuffer(stream_target, 0);
+    }
+    return allocation;
+}
+
+void commit(StreamBuffer &stream, const StreamAllocation &allocation) {
+    // Coherent mappings need nothing, the fence of the frame is issued after the draws
+    if (!stream.persistent && allocation.data) {
+        glBindBuffer(stream_target, stream.buffer);
+        glUnmapBuffer(stream_target);
+        glBindBuffer(stream_target, 0);
+    }
+}
+
+StreamAllocation upload(StreamBuffer &stream, const void *data, long size, long alignment) {
+    StreamAllocation allocation = allocate(stream, size, alignment);
+    if (allocation.data) {
+        std::memcpy(allocation.data, data, size);
+        commit(stream, allocation);
+    }
+    return allocation;
+}
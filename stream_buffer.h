@@ -0,0 +1,48 @@
+#pragma once
+
+// Ring buffer for the data written every frame: vertices of the debug lines and of the overlay,
+// draw commands and the frame uniforms. With GL 4.4 or ARB_buffer_storage the buffer holds one
+// region per frame in flight and stays mapped (persistent and coherent), a fence per region tells
+// when the GPU is done reading it, so writing is a plain memcpy without any call to the driver.
+// Otherwise the buffer is orphaned at the start of each frame and allocations are mapped
+// unsynchronized, they never overlap within a frame.
+
+#include <cstdint>
+
+constexpr int stream_frames = 3;
+
+struct StreamAllocation {
+    void *data = nullptr; // nullptr when the frame region is full
+    long offset = 0;      // in the buffer, to bind or to point attributes at
+    long size = 0;
+};
+
+struct StreamBuffer {
+    unsigned int buffer{};
+    bool persistent = false;
+    long frame_size = 0;
+    int frame = 0;   // region written this frame
+    long offset = 0; // in the region
+    long needed = 0; // bytes asked this frame, the regions grow to it
+    char *mapped = nullptr;
+    void *fences[stream_frames]{};
+    int uniform_alignment = 256;
+    int storage_alignment = 256;
+};
+
+StreamBuffer make_stream_buffer(long frame_size = 1 << 20);
+void free_stream_buffer(StreamBuffer &stream);
+
+// Waits for the GPU to be done with the region of this frame, grows the buffer if the last frame
+// did not fit.
+void begin_frame(StreamBuffer &stream);
+// Fences the commands that read the region of this frame.
+void end_frame(StreamBuffer &stream);
+
+StreamAllocation allocate(StreamBuffer &stream, long size, long alignment = 16);
+// Makes the written data visible to GL, to call before drawing with it and before the next
+// allocation, without persistent mapping only one allocation can be mapped at a time.
+void commit(StreamBuffer &stream, const StreamAllocation &allocation);
+
+// Allocates and copies in one go.
+StreamAllocation upload(StreamBuffer &stream, const void *data, long size, long alignment = 16);
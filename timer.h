@@ -10,9 +10,7 @@ class Timer {
 
     float seconds_elapsed() {
         auto new_timepoint = std::chrono::high_resolution_clock::now();
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(new_timepoint - m_timepoint)
-                      .count();
-        return ms / 1000.f;
+        return std::chrono::duration<float>(new_timepoint - m_timepoint).count();
     }
 
     float tick() {
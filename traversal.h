@@ -0,0 +1,80 @@
+#pragma once
+
+#include "raycast.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Amanatides & Woo, "A Fast Voxel Traversal Algorithm for Ray Tracing".
+//
+// Walks the cells of a rows x cols grid crossed by the ray, in the order the ray enters them.
+// Cell (row, col) covers x in [col, col + 1] and z in [-(row + 1), -row], at any height, so a
+// level only has one layer of cells. The visitor gets (row, col, t_enter, t_exit) and returns
+// true to stop the walk. It does not care how the cells are stored, the visitor looks up what
+// occupies a cell in a dense vector or in a hash map alike.
+template <typename Visitor>
+void traverse_cells(const Ray &ray, int rows, int cols, float max_distance, Visitor visit) {
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+
+    // (u, v) = (x, -z) so that rows and cols grow with the coordinates
+    float origin[2] = {ray.origin.x, -ray.origin.z};
+    float direction[2] = {ray.direction.x, -ray.direction.z};
+    float size[2] = {(float)cols, (float)rows};
+
+    // Clip the ray to the grid
+    float t_min = 0;
+    float t_max = max_distance;
+    for (int axis = 0; axis < 2; ++axis) {
+        if (direction[axis] == 0) {
+            if (origin[axis] < 0 || origin[axis] > size[axis]) {
+                return;
+            }
+            continue;
+        }
+        float t0 = (0 - origin[axis]) / direction[axis];
+        float t1 = (size[axis] - origin[axis]) / direction[axis];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+    }
+    if (t_min > t_max) {
+        return;
+    }
+
+    int cell[2];
+    int step[2];
+    float t_next[2];
+    float t_delta[2];
+    for (int axis = 0; axis < 2; ++axis) {
+        float entry = origin[axis] + direction[axis] * t_min;
+        cell[axis] = std::clamp((int)std::floor(entry), 0, (int)size[axis] - 1);
+        if (direction[axis] > 0) {
+            step[axis] = 1;
+            t_next[axis] = (cell[axis] + 1 - origin[axis]) / direction[axis];
+            t_delta[axis] = 1 / direction[axis];
+        } else if (direction[axis] < 0) {
+            step[axis] = -1;
+            t_next[axis] = (cell[axis] - origin[axis]) / direction[axis];
+            t_delta[axis] = -1 / direction[axis];
+        } else {
+            step[axis] = 0;
+            t_next[axis] = infinity;
+            t_delta[axis] = infinity;
+        }
+    }
+
+    float t = t_min;
+    while (true) {
+        int axis = t_next[0] < t_next[1] ? 0 : 1;
+        float t_exit = std::min(t_next[axis], t_max);
+        if (visit(cell[1], cell[0], t, t_exit) || t_exit >= t_max) {
+            return;
+        }
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= size[axis]) {
+            return;
+        }
+        t = t_next[axis];
+        t_next[axis] += t_delta[axis];
+    }
+}
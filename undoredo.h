@@ -1,5 +1,7 @@
 #pragma once
 
+#include "memory.h"
+
 #include <iostream>
 #include <variant>
 #include <vector>
@@ -47,5 +49,5 @@ template <typename ActionType, typename ApplyVisitor, typename UndoVisitor> clas
     }
 
     int m_last_applied;
-    std::vector<ActionType> m_actions;
+    std::vector<ActionType, TaggedAllocator<ActionType, MemoryTag::Editor>> m_actions;
 };
\ No newline at end of file